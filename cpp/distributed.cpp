@@ -0,0 +1,380 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <stdint.h>
+
+#include "table.h"
+#include "transport.h"
+
+void Table::distributed_pagerank(Transport &transport) {
+
+    if (shard_dir.empty()) {
+        error("Distributed pagerank needs a sharded graph");
+    }
+    changed_sources.clear();
+    if (num_rows == 0) {
+        return;
+    }
+    if (float_ranks) {
+        iterate_partition<float>(transport);
+    } else {
+        iterate_partition<double>(transport);
+    }
+}
+
+/*
+ * Appends the n values at v to the bytes of a message.
+ */
+template <class T>
+static void put_values(vector<char> &message, const T *v, size_t n) {
+    size_t at = message.size();
+    message.resize(at + n * sizeof(T));
+    memcpy(message.data() + at, v, n * sizeof(T));
+}
+
+template <class Rank>
+void Table::iterate_partition(Transport &transport) {
+
+    size_t me = transport.rank();
+    size_t num_workers = transport.size();
+    size_t num_shards = (num_rows + shard_rows - 1) / shard_rows;
+
+    /*
+     * Every worker owns a contiguous range of shards, of about the same
+     * total size; all of them work the ranges out the same way from the
+     * sizes recorded in the shard index.
+     */
+    vector<size_t> bounds(num_workers + 1, num_shards);
+    {
+        vector<size_t> sizes(num_shards);
+        size_t total = 0;
+        for (size_t s = 0; s < num_shards; s++) {
+            /* A shard weighs one unit per row plus one per in-link */
+            sizes[s] = min(shard_rows, num_rows - s * shard_rows)
+                + shard_arcs[s];
+            total += sizes[s];
+        }
+        /*
+         * Worker w starts at the first shard after a w / num_workers
+         * share of the total, but every worker gets at least a shard
+         * while there are enough of them.
+         */
+        size_t acc = 0;
+        size_t s = 0;
+        bounds[0] = 0;
+        for (size_t w = 1; w < num_workers; w++) {
+            while (s < num_shards && acc * num_workers < total * w) {
+                acc += sizes[s++];
+            }
+            if (num_shards < num_workers) {
+                bounds[w] = min(w, num_shards);
+            } else {
+                bounds[w] = min(max(s, bounds[w - 1] + 1),
+                                num_shards - (num_workers - w));
+            }
+        }
+    }
+    if (num_shards < num_workers && me == 0) {
+        cerr << "only " << num_shards << " shards for " << num_workers
+             << " workers, so " << num_workers - num_shards
+             << " of them have no rows; save the shards with fewer "
+             << "--shard-rows to use them all" << endl;
+    }
+    vector<size_t> row_bounds(num_workers + 1);
+    for (size_t w = 0; w <= num_workers; w++) {
+        row_bounds[w] = min(bounds[w] * shard_rows, num_rows);
+    }
+    size_t first = row_bounds[me];
+    size_t last = row_bounds[me + 1];
+    size_t num_own = last - first;
+
+    /* Only this worker's shards are loaded */
+    vector<size_t> offsets(1, 0);
+    vector<uint32_t> links;
+    {
+        vector<uint64_t> buf;
+        vector<size_t> shard_offsets;
+        const uint32_t *shard_links;
+        for (size_t s = bounds[me]; s < bounds[me + 1]; s++) {
+            size_t bytes;
+            if (!read_shard(s, buf, bytes)) {
+                error("Cannot read file", shard_name(s).c_str());
+            }
+            parse_shard(s, buf, bytes, shard_offsets, shard_links);
+            size_t base = links.size();
+            for (size_t i = 1; i < shard_offsets.size(); i++) {
+                offsets.push_back(base + shard_offsets[i]);
+            }
+            links.insert(links.end(), shard_links,
+                         shard_links + shard_offsets.back());
+        }
+    }
+
+    /*
+     * The contributions are kept for this worker's rows, followed by
+     * those of the other vertices its in-links refer to, the boundary,
+     * in order; the in-links are renumbered to match.
+     */
+    vector<uint32_t> boundary;
+    for (uint32_t j : links) {
+        if (j < first || j >= last) {
+            boundary.push_back(j);
+        }
+    }
+    sort(boundary.begin(), boundary.end());
+    boundary.erase(unique(boundary.begin(), boundary.end()), boundary.end());
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+    for (size_t k = 0; k < links.size(); k++) {
+        uint32_t j = links[k];
+        links[k] = (j >= first && j < last) ? j - first
+            : num_own + (lower_bound(boundary.begin(), boundary.end(), j)
+                         - boundary.begin());
+    }
+
+    /*
+     * Tell every worker which of its vertices' contributions are needed
+     * here, the part of the boundary from need_at[p] to need_at[p + 1];
+     * in return, learn which of ours each of them needs.
+     */
+    vector<size_t> need_at(num_workers + 1);
+    for (size_t p = 0; p <= num_workers; p++) {
+        need_at[p] = lower_bound(boundary.begin(), boundary.end(),
+                                 row_bounds[p]) - boundary.begin();
+    }
+    vector<vector<uint32_t> > gives(num_workers); // to each, numbered here
+    vector<vector<char> > out(num_workers);
+    vector<vector<char> > in(num_workers);
+    {
+        for (size_t p = 0; p < num_workers; p++) {
+            put_values(out[p], boundary.data() + need_at[p],
+                       need_at[p + 1] - need_at[p]);
+        }
+        transport.exchange(out, in);
+        for (size_t p = 0; p < num_workers; p++) {
+            if (p == me) {
+                continue;
+            }
+            const uint32_t *v = (const uint32_t *) in[p].data();
+            gives[p].assign(v, v + in[p].size() / sizeof(uint32_t));
+            for (uint32_t &j : gives[p]) {
+                if (j < first || j >= last) {
+                    error("Worker asked for a vertex it does not own");
+                }
+                j -= first;
+            }
+        }
+    }
+
+    double diff = 1;
+    double sum_pr;
+    double dangling_pr;
+    double one_Av, one_Iv;
+    num_iterations = 0;
+    RunStats::Mark start = stats.mark();
+    double exchange_time = 0; // seconds spent exchanging with other workers
+    size_t bytes_sent = 0;
+    const size_t *outgoing = num_outgoing.data();
+    vector<Rank> contrib(num_own + boundary.size());
+    vector<double> ranks(num_own); // the pagerank of this worker's rows
+    vector<double> inv_outgoing(num_own);
+    for (size_t i = first; i < last; i++) {
+        inv_outgoing[i - first] = outgoing[i] ? 1.0 / outgoing[i] : 0.0;
+    }
+
+    /*
+     * All workers have the sums of every block, and add them up in
+     * block order, so they agree on the reductions and get the same
+     * results as pagerank() in one process.
+     */
+    size_t num_blocks = (num_rows + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    vector<double> block_sum(num_blocks);
+    vector<double> block_dangling(num_blocks);
+    vector<double> block_diff(num_blocks);
+    auto first_block = [&](size_t w) { return row_bounds[w] / REDUCE_BLOCK; };
+    auto last_block = [&](size_t w) {
+        if (row_bounds[w + 1] == row_bounds[w]) {
+            return first_block(w);
+        }
+        return (row_bounds[w + 1] + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    };
+
+    if (first == 0 && num_own > 0) {
+        ranks[0] = 1;
+    }
+    sum_pr = 1;
+    dangling_pr = (outgoing[0] == 0) ? 1 : 0;
+    one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+    one_Iv = (1 - alpha) / num_rows;
+
+    stats.start_iterations();
+    while (diff > convergence && num_iterations < max_iterations) {
+
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+        for (size_t i = 0; i < num_own; i++) {
+            ranks[i] /= sum_pr;
+            contrib[i] = ranks[i] * inv_outgoing[i];
+        }
+
+        /* The contributions of the boundary vertices */
+        chrono::steady_clock::time_point wait = chrono::steady_clock::now();
+        vector<Rank> values;
+        for (size_t p = 0; p < num_workers; p++) {
+            values.resize(gives[p].size());
+            for (size_t k = 0; k < gives[p].size(); k++) {
+                values[k] = contrib[gives[p][k]];
+            }
+            out[p].clear();
+            put_values(out[p], values.data(), values.size());
+        }
+        bytes_sent += transport.exchange(out, in);
+        for (size_t p = 0; p < num_workers; p++) {
+            if (p == me) {
+                continue;
+            }
+            if (in[p].size() != (need_at[p + 1] - need_at[p]) * sizeof(Rank)) {
+                error("Unexpected message from worker");
+            }
+            memcpy(contrib.data() + num_own + need_at[p], in[p].data(),
+                   in[p].size());
+        }
+        exchange_time += chrono::duration<double>(chrono::steady_clock::now()
+                                                  - wait).count();
+
+        sweep_rows(contrib.data(), offsets.data(), links.data(), first,
+                   num_own, ranks.data(), one_Av, one_Iv, block_sum.data(),
+                   block_dangling.data(), block_diff.data());
+
+        /* Every worker's block sums go to all the others */
+        wait = chrono::steady_clock::now();
+        size_t b0 = first_block(me);
+        size_t b1 = last_block(me);
+        for (size_t p = 0; p < num_workers; p++) {
+            out[p].clear();
+            if (p != me) {
+                put_values(out[p], block_sum.data() + b0, b1 - b0);
+                put_values(out[p], block_dangling.data() + b0, b1 - b0);
+                put_values(out[p], block_diff.data() + b0, b1 - b0);
+            }
+        }
+        bytes_sent += transport.exchange(out, in);
+        for (size_t p = 0; p < num_workers; p++) {
+            if (p == me) {
+                continue;
+            }
+            size_t pb0 = first_block(p);
+            size_t nb = last_block(p) - pb0;
+            if (in[p].size() != 3 * nb * sizeof(double)) {
+                error("Unexpected message from worker");
+            }
+            const char *m = in[p].data();
+            memcpy(block_sum.data() + pb0, m, nb * sizeof(double));
+            memcpy(block_dangling.data() + pb0, m + nb * sizeof(double),
+                   nb * sizeof(double));
+            memcpy(block_diff.data() + pb0, m + 2 * nb * sizeof(double),
+                   nb * sizeof(double));
+        }
+        exchange_time += chrono::duration<double>(chrono::steady_clock::now()
+                                                  - wait).count();
+
+        diff = 0;
+        sum_pr = 0;
+        dangling_pr = 0;
+        for (size_t b = 0; b < num_blocks; b++) {
+            diff += block_diff[b];
+            sum_pr += block_sum[b];
+            dangling_pr += block_dangling[b];
+        }
+        one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+        num_iterations++;
+        stats.add_iteration(diff, dangling_pr / sum_pr, links.size());
+        if (verbose && me == 0) {
+            cerr << "iteration " << num_iterations << " diff = "
+                 << diff << endl;
+        }
+    }
+
+    for (size_t i = 0; i < num_own; i++) {
+        ranks[i] /= sum_pr;
+    }
+
+    /* Worker 0 collects the whole pagerank vector */
+    for (size_t p = 0; p < num_workers; p++) {
+        out[p].clear();
+    }
+    if (me != 0) {
+        put_values(out[0], ranks.data(), num_own);
+    }
+    transport.exchange(out, in);
+    if (me != 0) {
+        pr.swap(ranks);
+    } else {
+        pr.assign(num_rows, 0);
+        copy(ranks.begin(), ranks.end(), pr.begin());
+        for (size_t p = 1; p < num_workers; p++) {
+            size_t n = row_bounds[p + 1] - row_bounds[p];
+            if (in[p].size() != n * sizeof(double)) {
+                error("Unexpected message from worker");
+            }
+            memcpy(pr.data() + row_bounds[p], in[p].data(), in[p].size());
+        }
+    }
+
+    stats.add_phase("iterate", start);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now()
+                                              - start.time).count();
+    size_t iterations = max(num_iterations, 1UL);
+    ostringstream report;
+    report << "worker " << me << ": rows " << first << " to " << last
+           << ", " << links.size() << " in-links, sent "
+           << bytes_sent / iterations << " bytes and spent "
+           << exchange_time * 1000 / iterations
+           << " ms exchanging per iteration" << endl;
+    if (me == 0) {
+        report << "distributed power solver on " << num_workers
+               << " workers finished after " << num_iterations
+               << " iterations, diff = " << diff << ", "
+               << elapsed * 1000 / iterations << " ms per iteration" << endl;
+    }
+    cerr << report.str();
+}
+
+template void Table::iterate_partition<float>(Transport &);
+template void Table::iterate_partition<double>(Transport &);
@@ -0,0 +1,275 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "gather.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_GATHER 1
+/* GCC warns about the deliberately undefined vectors of some intrinsics */
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+template <class Index, class Rank>
+static void gather_rows_scalar(const Rank *contrib, const size_t *offsets,
+                               const Index *links, size_t first,
+                               size_t last, double *h) {
+    for (size_t i = first; i < last; i++) {
+        double sum = 0.0;
+        const Index *row_end = links + offsets[i + 1];
+        for (const Index *ci = links + offsets[i]; ci != row_end; ci++) {
+            sum += contrib[*ci];
+        }
+        h[i - first] = sum;
+    }
+}
+
+#ifdef HAVE_X86_GATHER
+
+/*
+ * The 32-bit gathers take signed indices, but the in-links are unsigned
+ * and reach 2^32 - 1. Flipping the top bit of an index makes it 2^31 less
+ * as a signed value, and biased() moves the base 2^31 elements up to
+ * make up for it, so every index is read where it points.
+ */
+static const int INDEX_FLIP = INT32_MIN;
+
+template <class Rank>
+static inline const Rank *biased(const Rank *contrib) {
+    return (const Rank *) ((uintptr_t) contrib
+                           + ((uintptr_t) 1 << 31) * sizeof(Rank));
+}
+
+/*
+ * Gathers contrib[ci[0..4)] as doubles, for each index and rank type.
+ */
+__attribute__((target("avx2")))
+static inline __m256d gather4(const size_t *ci, const double *contrib) {
+    __m256i idx = _mm256_loadu_si256((const __m256i *) ci);
+    return _mm256_i64gather_pd(contrib, idx, 8);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d gather4(const uint32_t *ci, const double *contrib) {
+    __m128i idx = _mm_xor_si128(_mm_loadu_si128((const __m128i *) ci),
+                                _mm_set1_epi32(INDEX_FLIP));
+    return _mm256_i32gather_pd(biased(contrib), idx, 8);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d gather4(const size_t *ci, const float *contrib) {
+    __m256i idx = _mm256_loadu_si256((const __m256i *) ci);
+    return _mm256_cvtps_pd(_mm256_i64gather_ps(contrib, idx, 4));
+}
+
+__attribute__((target("avx2")))
+static inline __m256d gather4(const uint32_t *ci, const float *contrib) {
+    __m128i idx = _mm_xor_si128(_mm_loadu_si128((const __m128i *) ci),
+                                _mm_set1_epi32(INDEX_FLIP));
+    return _mm256_cvtps_pd(_mm_i32gather_ps(biased(contrib), idx, 4));
+}
+
+template <class Index, class Rank>
+__attribute__((target("avx2")))
+static void gather_rows_avx2(const Rank *contrib, const size_t *offsets,
+                             const Index *links, size_t first, size_t last,
+                             double *h) {
+    for (size_t i = first; i < last; i++) {
+        const Index *ci = links + offsets[i];
+        size_t n = offsets[i + 1] - offsets[i];
+        size_t k = 0;
+        __m256d acc = _mm256_setzero_pd();
+        for (; k + 4 <= n; k += 4) {
+            acc = _mm256_add_pd(acc, gather4(ci + k, contrib));
+        }
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc),
+                               _mm256_extractf128_pd(acc, 1));
+        double sum = _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+        for (; k < n; k++) {
+            sum += contrib[ci[k]];
+        }
+        h[i - first] = sum;
+    }
+}
+
+/*
+ * Masked gather of contrib[ci[0..8)] as doubles into a zeroed vector;
+ * lanes not in mask are zero and their indices are not read.
+ */
+__attribute__((target("avx512f")))
+static inline __m512d gather8(const size_t *ci, const double *contrib,
+                              __mmask8 mask = 0xFF) {
+    __m512i idx = _mm512_maskz_loadu_epi64(mask, ci);
+    return _mm512_mask_i64gather_pd(_mm512_setzero_pd(), mask, idx, contrib,
+                                    8);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d gather8(const uint32_t *ci, const double *contrib,
+                              __mmask8 mask = 0xFF) {
+    __m256i idx = _mm512_castsi512_si256(
+        _mm512_xor_si512(_mm512_maskz_loadu_epi32(mask, ci),
+                         _mm512_set1_epi32(INDEX_FLIP)));
+    return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, idx,
+                                    biased(contrib), 8);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d gather8(const size_t *ci, const float *contrib,
+                              __mmask8 mask = 0xFF) {
+    __m512i idx = _mm512_maskz_loadu_epi64(mask, ci);
+    return _mm512_cvtps_pd(_mm512_mask_i64gather_ps(_mm256_setzero_ps(), mask,
+                                                    idx, contrib, 4));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d gather8(const uint32_t *ci, const float *contrib,
+                              __mmask8 mask = 0xFF) {
+    __m512i idx = _mm512_xor_si512(_mm512_maskz_loadu_epi32(mask, ci),
+                                   _mm512_set1_epi32(INDEX_FLIP));
+    __m512 v = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, idx,
+                                        biased(contrib), 4);
+    return _mm512_cvtps_pd(_mm512_castps512_ps256(v));
+}
+
+/*
+ * Adds contrib[ci[0..8)] to acc0 and contrib[ci[8..16)] to acc1.
+ */
+template <class Index, class Rank>
+__attribute__((target("avx512f")))
+static inline void gather16(const Index *ci, const Rank *contrib,
+                            __m512d &acc0, __m512d &acc1) {
+    acc0 = _mm512_add_pd(acc0, gather8(ci, contrib));
+    acc1 = _mm512_add_pd(acc1, gather8(ci + 8, contrib));
+}
+
+/* With 32-bit indices and floats all 16 values fit one gather */
+template <>
+__attribute__((target("avx512f")))
+inline void gather16(const uint32_t *ci, const float *contrib,
+                     __m512d &acc0, __m512d &acc1) {
+    __m512i idx = _mm512_xor_si512(_mm512_loadu_si512(ci),
+                                   _mm512_set1_epi32(INDEX_FLIP));
+    __m512 v = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, idx,
+                                        biased(contrib), 4);
+    __m256d hi = _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF,
+                                             _mm512_castps_pd(v), 1);
+    acc0 = _mm512_add_pd(acc0, _mm512_cvtps_pd(_mm512_castps512_ps256(v)));
+    acc1 = _mm512_add_pd(acc1, _mm512_cvtps_pd(_mm256_castpd_ps(hi)));
+}
+
+template <class Index, class Rank>
+__attribute__((target("avx512f")))
+static void gather_rows_avx512(const Rank *contrib, const size_t *offsets,
+                               const Index *links, size_t first,
+                               size_t last, double *h) {
+    for (size_t i = first; i < last; i++) {
+        const Index *ci = links + offsets[i];
+        size_t n = offsets[i + 1] - offsets[i];
+        size_t k = 0;
+        /* Short rows are the common case in power-law graphs */
+        if (n < 4) {
+            double sum = 0.0;
+            for (; k < n; k++) {
+                sum += contrib[ci[k]];
+            }
+            h[i - first] = sum;
+            continue;
+        }
+        __m512d acc0 = _mm512_setzero_pd();
+        __m512d acc1 = _mm512_setzero_pd();
+        for (; k + 16 <= n; k += 16) {
+            gather16(ci + k, contrib, acc0, acc1);
+        }
+        if (k + 8 <= n) {
+            acc0 = _mm512_add_pd(acc0, gather8(ci + k, contrib));
+            k += 8;
+        }
+        if (k < n) {
+            __mmask8 m = (__mmask8) ((1u << (n - k)) - 1);
+            acc1 = _mm512_add_pd(acc1, gather8(ci + k, contrib, m));
+        }
+        double lanes[8];
+        _mm512_storeu_pd(lanes, _mm512_add_pd(acc0, acc1));
+        h[i - first] = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]))
+            + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+}
+
+#endif
+
+template <class Index, class Rank>
+const GatherKernel<Index, Rank> &scalar_gather_kernel() {
+    static const GatherKernel<Index, Rank> kernel = {
+        "scalar", gather_rows_scalar<Index, Rank>
+    };
+    return kernel;
+}
+
+template <class Index, class Rank>
+static const GatherKernel<Index, Rank> &detect_gather_kernel() {
+#ifdef HAVE_X86_GATHER
+    static const GatherKernel<Index, Rank> AVX512_KERNEL = {
+        "avx512", gather_rows_avx512<Index, Rank>
+    };
+    static const GatherKernel<Index, Rank> AVX2_KERNEL = {
+        "avx2", gather_rows_avx2<Index, Rank>
+    };
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return AVX512_KERNEL;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return AVX2_KERNEL;
+    }
+#endif
+    return scalar_gather_kernel<Index, Rank>();
+}
+
+template <class Index, class Rank>
+const GatherKernel<Index, Rank> &best_gather_kernel() {
+    static const GatherKernel<Index, Rank> &kernel =
+        detect_gather_kernel<Index, Rank>();
+    return kernel;
+}
+
+template const GatherKernel<uint32_t, float> &best_gather_kernel();
+template const GatherKernel<uint32_t, double> &best_gather_kernel();
+template const GatherKernel<size_t, float> &best_gather_kernel();
+template const GatherKernel<size_t, double> &best_gather_kernel();
+template const GatherKernel<uint32_t, float> &scalar_gather_kernel();
+template const GatherKernel<uint32_t, double> &scalar_gather_kernel();
+template const GatherKernel<size_t, float> &scalar_gather_kernel();
+template const GatherKernel<size_t, double> &scalar_gather_kernel();
@@ -0,0 +1,77 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef GATHER_H
+#define GATHER_H
+
+#include <cstddef>
+#include <stdint.h>
+
+/*
+ * A gather implementation together with a name for reporting. The
+ * in-links of the hyperlink matrix are of type Index (uint32_t or
+ * size_t) and the contributions of the columns are of type Rank (float
+ * or double); the sums are always accumulated in double.
+ *
+ * gather_rows computes, for each row i in [first, last) of a hyperlink
+ * matrix in compressed sparse row form, the sum of contrib[links[k]]
+ * over the in-links k of the row, and stores it in h[i - first]. For a
+ * given Rank the additions are done in the same order whatever Index
+ * is, so the index type does not change the results.
+ */
+template <class Index, class Rank>
+struct GatherKernel {
+    typedef void (*gather_rows_fn)(const Rank *contrib, const size_t *offsets,
+                                   const Index *links, size_t first,
+                                   size_t last, double *h);
+    const char *name;
+    gather_rows_fn gather_rows;
+};
+
+/*
+ * Returns the fastest gather implementation supported by the CPU we are
+ * running on: AVX-512, AVX2 or plain scalar code. The choice is made
+ * with CPUID the first time the function is called. Implemented for
+ * Index uint32_t and size_t and Rank float and double.
+ */
+template <class Index, class Rank>
+const GatherKernel<Index, Rank> &best_gather_kernel();
+
+/*
+ * Returns the portable scalar gather implementation.
+ */
+template <class Index, class Rank>
+const GatherKernel<Index, Rank> &scalar_gather_kernel();
+
+#endif
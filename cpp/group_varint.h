@@ -0,0 +1,118 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef GROUP_VARINT_H
+#define GROUP_VARINT_H
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+
+/*
+ * Group varint coding of 32-bit values: values are coded in groups of
+ * four, as a control byte holding the length minus one of each value,
+ * in bits 2j..2j+1 for value j, followed by the low 1 to 4 bytes of the
+ * values, little endian. A short last group is padded with zeros. As
+ * the lengths of a group are known from its control byte alone, the
+ * values are decoded without a dependency from one to the next, which
+ * makes decoding several times faster than with byte-wise varints.
+ */
+
+/* Bytes that must be readable after the coded values for decoding */
+const size_t GROUP_VARINT_PADDING = 3;
+
+inline size_t group_varint_length(uint32_t v) {
+    return 1 + (v >= (1u << 8)) + (v >= (1u << 16)) + (v >= (1u << 24));
+}
+
+/*
+ * Returns the number of bytes put_group_varint() needs for n values.
+ */
+inline size_t group_varint_size(const uint32_t *v, size_t n) {
+    size_t bytes = (n + 3) / 4 + (4 - n % 4) % 4;
+    for (size_t k = 0; k < n; k++) {
+        bytes += group_varint_length(v[k]);
+    }
+    return bytes;
+}
+
+/*
+ * Codes the n values at v at p and returns the byte after them.
+ */
+inline uint8_t *put_group_varint(uint8_t *p, const uint32_t *v, size_t n) {
+    for (size_t k = 0; k < n; k += 4) {
+        uint8_t *control = p++;
+        *control = 0;
+        for (size_t j = 0; j < 4; j++) {
+            uint32_t value = (k + j < n) ? v[k + j] : 0;
+            size_t len = group_varint_length(value);
+            *control |= (uint8_t) ((len - 1) << (2 * j));
+            for (size_t b = 0; b < len; b++) {
+                *p++ = (uint8_t) (value >> (8 * b));
+            }
+        }
+    }
+    return p;
+}
+
+/*
+ * Decodes n values from p into v, which must have room for n rounded up
+ * to a multiple of four, and returns the byte after them.
+ */
+inline const uint8_t *get_group_varint(const uint8_t *p, uint32_t *v,
+                                       size_t n) {
+    static const uint32_t MASK[4] = {
+        0xff, 0xffff, 0xffffff, 0xffffffff
+    };
+    for (size_t k = 0; k < n; k += 4) {
+        unsigned control = *p++;
+        size_t l0 = (control & 3) + 1;
+        size_t l1 = ((control >> 2) & 3) + 1;
+        size_t l2 = ((control >> 4) & 3) + 1;
+        size_t l3 = (control >> 6) + 1;
+        uint32_t w0, w1, w2, w3;
+        memcpy(&w0, p, 4);
+        memcpy(&w1, p + l0, 4);
+        memcpy(&w2, p + l0 + l1, 4);
+        memcpy(&w3, p + l0 + l1 + l2, 4);
+        v[k] = w0 & MASK[l0 - 1];
+        v[k + 1] = w1 & MASK[l1 - 1];
+        v[k + 2] = w2 & MASK[l2 - 1];
+        v[k + 3] = w3 & MASK[l3 - 1];
+        p += l0 + l1 + l2 + l3;
+    }
+    return p;
+}
+
+#endif
@@ -0,0 +1,92 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "id_map.h"
+
+using namespace std;
+
+/* The table is kept at most half full */
+static const size_t MIN_CAPACITY = 1024;
+
+void IdMap::grow(size_t capacity) {
+    vector<uint64_t> old_keys;
+    vector<size_t> old_values;
+    old_keys.swap(keys);
+    old_values.swap(values);
+    keys.assign(capacity, 0);
+    values.assign(capacity, NOT_FOUND);
+    size_t mask = capacity - 1;
+    for (size_t s = 0; s < old_values.size(); s++) {
+        if (old_values[s] != NOT_FOUND) {
+            size_t slot = slot_of(old_keys[s], mask);
+            while (values[slot] != NOT_FOUND) {
+                slot = (slot + 1) & mask;
+            }
+            keys[slot] = old_keys[s];
+            values[slot] = old_values[s];
+        }
+    }
+}
+
+void IdMap::reserve(size_t n) {
+    size_t capacity = keys.empty() ? MIN_CAPACITY : keys.size();
+    while (capacity < 2 * n) {
+        capacity *= 2;
+    }
+    if (capacity != keys.size()) {
+        grow(capacity);
+    }
+}
+
+bool IdMap::insert(uint64_t id, size_t value) {
+    reserve(count + 1);
+    size_t mask = keys.size() - 1;
+    size_t slot = slot_of(id, mask);
+    while (values[slot] != NOT_FOUND) {
+        if (keys[slot] == id) {
+            return false;
+        }
+        slot = (slot + 1) & mask;
+    }
+    keys[slot] = id;
+    values[slot] = value;
+    count++;
+    return true;
+}
+
+void IdMap::clear() {
+    vector<uint64_t>().swap(keys);
+    vector<size_t>().swap(values);
+    count = 0;
+}
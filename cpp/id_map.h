@@ -0,0 +1,105 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef ID_MAP_H
+#define ID_MAP_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+/*
+ * A hash map from 64-bit integer IDs to indices, using open addressing
+ * with linear probing. Lookups do not modify the map, so any number of
+ * threads may call find() concurrently as long as nobody inserts.
+ */
+class IdMap {
+private:
+    std::vector<uint64_t> keys;
+    std::vector<size_t> values; // NOT_FOUND marks an empty slot
+    size_t count;
+
+    static size_t slot_of(uint64_t id, size_t mask) {
+        /* The splitmix64 finaliser */
+        id ^= id >> 30;
+        id *= 0xbf58476d1ce4e5b9ULL;
+        id ^= id >> 27;
+        id *= 0x94d049bb133111ebULL;
+        id ^= id >> 31;
+        return id & mask;
+    }
+
+    void grow(size_t capacity);
+
+public:
+    static constexpr size_t NOT_FOUND = (size_t) -1;
+
+    IdMap() : count(0) { }
+
+    /*
+     * Makes room for n IDs, so that they can be inserted without the
+     * map having to grow.
+     */
+    void reserve(size_t n);
+
+    /*
+     * Maps id to value, unless id is already mapped. Returns true if
+     * id was inserted.
+     */
+    bool insert(uint64_t id, size_t value);
+
+    /*
+     * Returns the value id is mapped to, or NOT_FOUND.
+     */
+    size_t find(uint64_t id) const {
+        if (count == 0) {
+            return NOT_FOUND;
+        }
+        size_t mask = keys.size() - 1;
+        size_t slot = slot_of(id, mask);
+        while (values[slot] != NOT_FOUND) {
+            if (keys[slot] == id) {
+                return values[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+        return NOT_FOUND;
+    }
+
+    size_t size() const { return count; }
+
+    void clear();
+};
+
+#endif
@@ -0,0 +1,485 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <map>
+#include <limits>
+#include <math.h>
+#include <string>
+#include <cstdlib>
+
+#include "table.h"
+
+/*
+ * Applies a batch of changes, given as sorted (row, column) pairs, to the
+ * matrix in compressed sparse row form in offsets and links, which grows
+ * to num_rows rows: the added arcs are inserted and the removed ones
+ * deleted, so no arc may be in both. Rows stay sorted and free of
+ * duplicates; added arcs that are already in the matrix and removed
+ * arcs that are not are ignored. Rows without changes are copied as
+ * they are.
+ */
+static void merge_arcs(MappedArray<size_t> &offsets, MappedArray<size_t> &links,
+                       size_t num_rows,
+                       const vector<pair<size_t, size_t> > &added,
+                       const vector<pair<size_t, size_t> > &removed) {
+
+    size_t old_rows = offsets.empty() ? 0 : offsets.size() - 1;
+    vector<size_t> new_offsets(num_rows + 1);
+    vector<size_t> new_links;
+    new_links.reserve(links.size() + added.size());
+
+    vector<pair<size_t, size_t> >::const_iterator ca = added.begin();
+    vector<pair<size_t, size_t> >::const_iterator cr = removed.begin();
+    for (size_t i = 0; i < num_rows; i++) {
+        const size_t *first = links.data();
+        const size_t *last = links.data();
+        if (i < old_rows) {
+            first += offsets[i];
+            last += offsets[i + 1];
+        }
+        new_offsets[i] = new_links.size();
+        bool adds = (ca != added.end() && ca->first == i);
+        if (!adds && (cr == removed.end() || cr->first != i)) {
+            new_links.insert(new_links.end(), first, last);
+            continue;
+        }
+        /* Merge the row with the additions to it, less the removals */
+        while (first != last || adds) {
+            size_t j;
+            if (!adds || (first != last && *first <= ca->second)) {
+                j = *first++;
+                if (adds && ca->second == j) {
+                    ca++;
+                }
+            } else {
+                j = ca->second;
+                ca++;
+            }
+            adds = (ca != added.end() && ca->first == i);
+            while (cr != removed.end() && cr->first == i && cr->second < j) {
+                cr++;
+            }
+            if (cr == removed.end() || cr->first != i || cr->second != j) {
+                new_links.push_back(j);
+            }
+        }
+        while (cr != removed.end() && cr->first == i) {
+            cr++;
+        }
+    }
+    new_offsets[num_rows] = new_links.size();
+
+    offsets.clear();
+    offsets.edit().swap(new_offsets);
+    links.clear();
+    links.edit().swap(new_links);
+}
+
+/*
+ * Sorts arcs and drops the duplicates.
+ */
+static void sort_arcs(vector<pair<size_t, size_t> > &arcs) {
+    sort(arcs.begin(), arcs.end());
+    arcs.erase(unique(arcs.begin(), arcs.end()), arcs.end());
+}
+
+/*
+ * Turns (from, to) arcs into (to, from) ones, sorted.
+ */
+static void transpose_arcs(vector<pair<size_t, size_t> > &arcs) {
+    for (size_t k = 0; k < arcs.size(); k++) {
+        swap(arcs[k].first, arcs[k].second);
+    }
+    sort(arcs.begin(), arcs.end());
+}
+
+void Table::build_out_links() {
+
+    if (row_offsets.size() != num_rows + 1) {
+        build_graph();
+    }
+    unpack_links();
+
+    vector<size_t> offsets(num_rows + 1);
+    for (size_t j = 0; j < num_rows; j++) {
+        offsets[j + 1] = offsets[j] + num_outgoing[j];
+    }
+    vector<size_t> links(offsets[num_rows]);
+    vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < num_rows; i++) {
+        for (size_t k = row_offsets[i]; k < row_offsets[i + 1]; k++) {
+            links[next[in_links[k]]++] = i;
+        }
+    }
+
+    out_offsets.clear();
+    out_offsets.edit().swap(offsets);
+    out_links.clear();
+    out_links.edit().swap(links);
+}
+
+void Table::change_arcs(vector<pair<size_t, size_t> > added,
+                        vector<pair<size_t, size_t> > removed,
+                        size_t rows) {
+
+    unpack_links();
+    if (out_offsets.size() != num_rows + 1) {
+        build_out_links();
+    }
+
+    rows = max(rows, num_rows);
+    vector<pair<size_t, size_t> >::iterator ca;
+    for (ca = added.begin(); ca != added.end(); ca++) {
+        rows = max(rows, max(ca->first, ca->second) + 1);
+    }
+    /* Arcs of vertices that do not exist yet cannot be removed */
+    for (ca = removed.begin(); ca != removed.end(); ) {
+        if (ca->first >= num_rows || ca->second >= num_rows) {
+            ca = removed.erase(ca);
+        } else {
+            ca++;
+        }
+    }
+    sort_arcs(added);
+    sort_arcs(removed);
+
+    /* The vertices whose out-links change */
+    vector<size_t> sources;
+    for (ca = added.begin(); ca != added.end(); ca++) {
+        sources.push_back(ca->first);
+    }
+    for (ca = removed.begin(); ca != removed.end(); ca++) {
+        sources.push_back(ca->first);
+    }
+    sort(sources.begin(), sources.end());
+    sources.erase(unique(sources.begin(), sources.end()), sources.end());
+
+    /* Save the out-links that update_pagerank() has to take back */
+    for (size_t from : sources) {
+        if (changed_sources.count(from)) {
+            continue;
+        }
+        vector<size_t> &old_links = changed_sources[from];
+        if (from < num_rows) {
+            old_links.assign(out_links.begin() + out_offsets[from],
+                             out_links.begin() + out_offsets[from + 1]);
+        }
+    }
+
+    merge_arcs(out_offsets, out_links, rows, added, removed);
+    transpose_arcs(added);
+    transpose_arcs(removed);
+    merge_arcs(row_offsets, in_links, rows, added, removed);
+    drop_link_copies();
+
+    num_rows = rows;
+    vector<size_t> &outgoing = num_outgoing.edit();
+    outgoing.resize(num_rows);
+    for (size_t from : sources) {
+        outgoing[from] = out_offsets[from + 1] - out_offsets[from];
+    }
+}
+
+void Table::add_arcs(const vector<pair<size_t, size_t> > &arcs) {
+    change_arcs(arcs, vector<pair<size_t, size_t> >(), 0);
+}
+
+void Table::remove_arcs(const vector<pair<size_t, size_t> > &arcs) {
+    change_arcs(vector<pair<size_t, size_t> >(), arcs, 0);
+}
+
+size_t Table::vertex_index(const string &name, bool create) {
+    if (!numeric) {
+        return create ? insert_mapping(name)
+            : node_names.find(name.data(), name.size());
+    }
+    if (!remap) {
+        size_t index = strtol(name.c_str(), NULL, 10);
+        return (create || index < num_rows) ? index : IdMap::NOT_FOUND;
+    }
+    if (id_index.size() != node_ids.size()) {
+        id_index.clear();
+        id_index.reserve(node_ids.size());
+        for (size_t i = 0; i < node_ids.size(); i++) {
+            id_index.insert(node_ids[i], i);
+        }
+    }
+    uint64_t id = strtoull(name.c_str(), NULL, 10);
+    size_t index = id_index.find(id);
+    if (index == IdMap::NOT_FOUND && create) {
+        index = node_ids.size();
+        node_ids.edit().push_back(id);
+        id_index.insert(id, index);
+    }
+    return index;
+}
+
+size_t Table::find_vertex(const string &name) {
+    return vertex_index(name, false);
+}
+
+int Table::read_changes(const string &filename) {
+
+    ifstream infile(filename.c_str());
+    if (!infile) {
+        error("Cannot open file", filename.c_str());
+    }
+
+    /*
+     * The whole file is applied at once, as one set of arcs to add and
+     * one to remove: of several changes to the same arc, the last wins.
+     */
+    map<pair<size_t, size_t>, bool> changes; // arc to whether it is removed
+    size_t rows = num_rows; // including the vertices the file adds
+    size_t num_added = 0;
+    size_t num_removed = 0;
+
+    /*
+     * Numeric vertices exist if they are in the graph or were added by
+     * an earlier line, which has not been applied yet.
+     */
+    auto lookup = [&](const string &name, bool create) {
+        if (!numeric || remap) {
+            return vertex_index(name, create);
+        }
+        size_t index = strtol(name.c_str(), NULL, 10);
+        return (create || index < rows) ? index : IdMap::NOT_FOUND;
+    };
+
+    string line;
+    while (getline(infile, line)) {
+        trim(line);
+        if (line.empty()) {
+            continue;
+        }
+        bool remove = (line[0] == '-');
+        if (!remove && line[0] != '+') {
+            error("Invalid change, expected + or -:", line.c_str());
+        }
+        line.erase(0, 1);
+        trim(line);
+        size_t pos = line.find(delim);
+        if (pos == string::npos) {
+            error("Invalid change, missing delimiter:", line.c_str());
+        }
+        string from = line.substr(0, pos);
+        string to = line.substr(pos + delim.length());
+        trim(from);
+        trim(to);
+        size_t from_idx = lookup(from, !remove);
+        size_t to_idx = lookup(to, !remove);
+        if (from_idx != IdMap::NOT_FOUND && to_idx != IdMap::NOT_FOUND) {
+            changes[make_pair(from_idx, to_idx)] = remove;
+            if (!remove) {
+                rows = max(rows, max(from_idx, to_idx) + 1);
+            }
+        }
+        if (remove) {
+            num_removed++;
+        } else {
+            num_added++;
+        }
+    }
+
+    vector<pair<size_t, size_t> > added;
+    vector<pair<size_t, size_t> > removed;
+    map<pair<size_t, size_t>, bool>::const_iterator cc;
+    for (cc = changes.begin(); cc != changes.end(); cc++) {
+        (cc->second ? removed : added).push_back(cc->first);
+    }
+    if (!added.empty() || !removed.empty() || rows > num_rows) {
+        change_arcs(added, removed, rows);
+    }
+
+    cerr << "read " << num_added << " arcs to add and " << num_removed
+         << " arcs to remove, " << num_rows << " vertices" << endl;
+    return 0;
+}
+
+void Table::update_pagerank() {
+
+    if (pr.empty() || num_rows == 0) {
+        pagerank();
+        return;
+    }
+    if (out_offsets.size() != num_rows + 1) {
+        build_out_links();
+    }
+
+    RunStats::Mark start = stats.mark();
+    size_t old_rows = pr.size();
+    pr.resize(num_rows, 0);
+    vector<double> residual(num_rows);
+    vector<char> queued(num_rows);
+    vector<char> held(num_rows); // whether i is in holding
+    vector<size_t> holding; // the vertices that may have a residual
+    deque<size_t> queue;
+    double threshold = numeric_limits<double>::infinity();
+    map<size_t, vector<size_t> >::const_iterator cs;
+
+    /*
+     * Adds delta to the residual of vertex i, queueing i for a push once
+     * its residual reaches the threshold of the round.
+     */
+    auto add_residual = [&](size_t i, double delta) {
+        residual[i] += delta;
+        if (!held[i]) {
+            held[i] = 1;
+            holding.push_back(i);
+        }
+        if (!queued[i] && fabs(residual[i]) >= threshold) {
+            queued[i] = 1;
+            queue.push_back(i);
+        }
+    };
+
+    /*
+     * Every old vertex already has its share of the teleportation and
+     * dangling vertex terms. Changes to these terms are the same for all
+     * vertices, so they only scale the vector and are taken care of by
+     * normalisation, but new vertices must be given their share.
+     */
+    if (num_rows > old_rows) {
+        double dangling_pr = 0;
+        for (size_t j = 0; j < old_rows; j++) {
+            cs = changed_sources.find(j);
+            size_t old_outgoing = (cs == changed_sources.end())
+                ? num_outgoing[j] : cs->second.size();
+            if (old_outgoing == 0) {
+                dangling_pr += pr[j];
+            }
+        }
+        double share = (1 - alpha + alpha * dangling_pr) / old_rows;
+        for (size_t i = old_rows; i < num_rows; i++) {
+            add_residual(i, share);
+        }
+    }
+
+    /* Take back the old contributions of changed vertices, add the new */
+    for (cs = changed_sources.begin(); cs != changed_sources.end(); cs++) {
+        size_t j = cs->first;
+        const vector<size_t> &old_links = cs->second;
+        for (size_t k = 0; k < old_links.size(); k++) {
+            add_residual(old_links[k], -alpha * pr[j] / old_links.size());
+        }
+        for (size_t k = out_offsets[j]; k < out_offsets[j + 1]; k++) {
+            add_residual(out_links[k], alpha * pr[j] / num_outgoing[j]);
+        }
+    }
+    changed_sources.clear();
+
+    /*
+     * The power method stops once successive vectors differ by less
+     * than convergence, which is the L1 norm of its residual, so the
+     * update stops when the residuals left add up to no more. They are
+     * pushed along out-links in rounds: each round pushes the vertices
+     * whose residual is at least half the mean of those that have one,
+     * which hold at least half of the total, so the work follows the
+     * pagerank the changes moved rather than the number of vertices.
+     * A change that moves rank across most of the graph costs more to
+     * push than to recalculate; once the arcs pushed pass the arcs the
+     * last full calculation went through, the rest is left to it.
+     */
+    size_t num_pushes = 0;
+    size_t num_arcs = 0;
+    size_t num_rounds = 0;
+    size_t budget = max(num_iterations, 1UL) * out_offsets[num_rows];
+    double target = convergence;
+    while (num_arcs <= budget) {
+        double total = 0;
+        size_t kept = 0;
+        for (size_t i : holding) {
+            if (residual[i] != 0) {
+                total += fabs(residual[i]);
+                holding[kept++] = i;
+            } else {
+                held[i] = 0;
+            }
+        }
+        holding.resize(kept);
+        if (total <= target) {
+            break;
+        }
+        threshold = total / (2 * holding.size());
+        for (size_t i : holding) {
+            if (fabs(residual[i]) >= threshold) {
+                queued[i] = 1;
+                queue.push_back(i);
+            }
+        }
+        while (!queue.empty() && num_arcs <= budget) {
+            size_t j = queue.front();
+            queue.pop_front();
+            queued[j] = 0;
+            double r = residual[j];
+            residual[j] = 0;
+            pr[j] += r;
+            num_pushes++;
+            if (num_outgoing[j] == 0) {
+                /* Spread evenly over all vertices; normalisation does that */
+                continue;
+            }
+            double push = alpha * r / num_outgoing[j];
+            for (size_t k = out_offsets[j]; k < out_offsets[j + 1]; k++) {
+                add_residual(out_links[k], push);
+            }
+            num_arcs += num_outgoing[j];
+        }
+        num_rounds++;
+    }
+    if (num_arcs > budget) {
+        stats.add_phase("update", start);
+        cerr << "update pushed " << num_arcs << " arcs, more than a full "
+             << "calculation, recalculating" << endl;
+        pagerank();
+        return;
+    }
+
+    double sum_pr = 0;
+    for (size_t i = 0; i < num_rows; i++) {
+        sum_pr += pr[i];
+    }
+    for (size_t i = 0; i < num_rows; i++) {
+        pr[i] /= sum_pr;
+    }
+    stats.add_phase("update", start);
+
+    cerr << "update pushed " << num_pushes << " residuals along "
+         << num_arcs << " arcs in " << num_rounds << " rounds" << endl;
+}
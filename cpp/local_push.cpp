@@ -0,0 +1,135 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <string>
+#include <limits>
+
+#include "table.h"
+
+void Table::local_pagerank(size_t seed, double epsilon, size_t k,
+                           vector<pair<size_t, double> > &top) {
+
+    top.clear();
+    if (seed >= num_rows) {
+        return;
+    }
+    if (out_offsets.size() != num_rows + 1) {
+        build_out_links();
+    }
+
+    /*
+     * Only the vertices reached by the push get a slot; slots holds the
+     * slot of each of them, so nothing is proportional to the size of
+     * the graph.
+     */
+    IdMap slots;
+    vector<size_t> vertices;
+    vector<double> p; // the approximate pagerank
+    vector<double> r; // the residual, still to be spread
+    vector<char> queued;
+    deque<size_t> queue;
+    size_t num_pushes = 0;
+
+    auto slot_of = [&](size_t v) {
+        size_t s = slots.find(v);
+        if (s == IdMap::NOT_FOUND) {
+            s = vertices.size();
+            slots.insert(v, s);
+            vertices.push_back(v);
+            p.push_back(0);
+            r.push_back(0);
+            queued.push_back(0);
+        }
+        return s;
+    };
+
+    /* Vertex v is pushed while its residual is at least epsilon per link */
+    auto add_residual = [&](size_t v, double delta) {
+        size_t s = slot_of(v);
+        r[s] += delta;
+        if (!queued[s] && r[s] >= epsilon * max(num_outgoing[v], (size_t) 1)) {
+            queued[s] = 1;
+            queue.push_back(s);
+        }
+    };
+
+    add_residual(seed, 1.0);
+    while (!queue.empty()) {
+        size_t s = queue.front();
+        queue.pop_front();
+        queued[s] = 0;
+        size_t v = vertices[s];
+        double rv = r[s];
+        r[s] = 0;
+        p[s] += (1 - alpha) * rv;
+        num_pushes++;
+        size_t deg = num_outgoing[v];
+        if (deg == 0) {
+            /*
+             * Dangling vertices jump back to the seed; a dangling seed
+             * would get all of its residual back, so it keeps it all.
+             */
+            if (v == seed) {
+                p[s] += alpha * rv;
+            } else {
+                add_residual(seed, alpha * rv);
+            }
+            continue;
+        }
+        double push = alpha * rv / deg;
+        for (size_t e = out_offsets[v]; e < out_offsets[v + 1]; e++) {
+            add_residual(out_links[e], push);
+        }
+    }
+
+    for (size_t s = 0; s < vertices.size(); s++) {
+        if (p[s] > 0) {
+            top.push_back(make_pair(vertices[s], p[s]));
+        }
+    }
+    if (k > 0 && k < top.size()) {
+        partial_sort(top.begin(), top.begin() + k, top.end(), higher_rank);
+        top.resize(k);
+    } else {
+        sort(top.begin(), top.end(), higher_rank);
+    }
+
+    cerr << "local push from " << get_node_name(seed) << " reached "
+         << vertices.size() << " vertices with " << num_pushes << " pushes"
+         << endl;
+}
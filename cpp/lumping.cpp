@@ -0,0 +1,228 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+
+#include "table.h"
+#include "openmp.h"
+#include "gather.h"
+
+bool Table::dangling_last() {
+    size_t v = 0;
+    while (v < num_rows && num_outgoing[v] > 0) {
+        v++;
+    }
+    while (v < num_rows && num_outgoing[v] == 0) {
+        v++;
+    }
+    return v == num_rows;
+}
+
+template <class Index, class Rank>
+void Table::iterate_lumped(const Index *links) {
+
+    double diff = 1;
+    double sum_pr;
+    double dangling_pr; // of the lumped dangling vertices
+    double one_Av, one_Iv;
+    double last_Av = 0; // one_Av of the last iteration
+    num_iterations = 0;
+    RunStats::Mark start = stats.mark();
+
+    const size_t *offsets = row_offsets.data();
+    const size_t *outgoing = num_outgoing.data();
+    const GatherKernel<Index, Rank> &kernel = best_gather_kernel<Index, Rank>();
+    vector<size_t> bounds;
+
+    /* Only the vertices with out-links, which come first, are iterated */
+    size_t linked = 0;
+    while (linked < num_rows && outgoing[linked] > 0) {
+        linked++;
+    }
+    size_t num_dangling = num_rows - linked;
+    double num_arcs = offsets[linked];
+    vector<Rank> contrib(linked);
+    vector<double> inv_outgoing(linked);
+    vector<double> leak(linked); // share of the out-links to dangling vertices
+
+    for (size_t k = offsets[linked]; k < offsets[num_rows]; k++) {
+        leak[links[k]]++;
+    }
+    for (size_t k = 0; k < linked; k++) {
+        inv_outgoing[k] = 1.0 / outgoing[k];
+        leak[k] *= inv_outgoing[k];
+    }
+
+    size_t num_blocks = (linked + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    vector<double> block_sum(num_blocks);
+    vector<double> block_leak(num_blocks);
+    vector<double> block_diff(num_blocks);
+
+    pr.assign(num_rows, 0);
+    if (linked > 0) {
+        pr[0] = 1;
+        dangling_pr = 0;
+    } else {
+        dangling_pr = 1;
+    }
+    sum_pr = 1;
+    one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+    one_Iv = (1 - alpha) / num_rows;
+
+    stats.start_iterations();
+#pragma omp parallel num_threads(num_threads)
+    {
+#pragma omp single
+        partition_rows(omp_get_num_threads(), bounds, linked);
+
+        size_t t = omp_get_thread_num();
+        size_t first_row = min(bounds[t] * REDUCE_BLOCK, linked);
+        size_t last_row = min(bounds[t + 1] * REDUCE_BLOCK, linked);
+        vector<double> h(REDUCE_BLOCK);
+
+        while (diff > convergence && num_iterations < max_iterations) {
+
+            for (size_t i = first_row; i < last_row; i++) {
+                pr[i] /= sum_pr;
+                contrib[i] = pr[i] * inv_outgoing[i];
+            }
+
+#pragma omp barrier
+
+            for (size_t b = bounds[t]; b < bounds[t + 1]; b++) {
+                size_t first = b * REDUCE_BLOCK;
+                size_t last = min(first + REDUCE_BLOCK, linked);
+                double bsum = 0;
+                double bleak = 0;
+                double bdiff = 0;
+                kernel.gather_rows(contrib.data(), offsets, links, first, last,
+                                   h.data());
+                for (size_t i = first; i < last; i++) {
+                    double cpr = alpha * h[i - first] + one_Av + one_Iv;
+                    bdiff += fabs(cpr - pr[i]);
+                    bleak += pr[i] * leak[i];
+                    pr[i] = cpr;
+                    bsum += cpr;
+                }
+                block_sum[b] = bsum;
+                block_leak[b] = bleak;
+                block_diff[b] = bdiff;
+            }
+
+#pragma omp barrier
+#pragma omp single
+            {
+                double leaked = 0;
+                diff = 0;
+                double prev_dangling = dangling_pr / sum_pr;
+                sum_pr = 0;
+                for (size_t b = 0; b < num_blocks; b++) {
+                    diff += block_diff[b];
+                    sum_pr += block_sum[b];
+                    leaked += block_leak[b];
+                }
+                /*
+                 * Every dangling vertex gets the same shares of the
+                 * teleport and dangling pagerank, besides the pagerank
+                 * that leaks into it from its in-links.
+                 */
+                dangling_pr = alpha * leaked
+                    + num_dangling * (one_Av + one_Iv);
+                diff += fabs(dangling_pr - prev_dangling);
+                sum_pr += dangling_pr;
+                last_Av = one_Av;
+                one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+                num_iterations++;
+                stats.add_iteration(diff, dangling_pr / sum_pr, num_arcs);
+                if (verbose) {
+                    cerr << "iteration " << num_iterations << " diff = "
+                         << diff << endl;
+                }
+            }
+        }
+    }
+
+    stats.add_phase("iterate", start);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now()
+                                              - start.time).count();
+    RunStats::Mark recover = stats.mark();
+
+    /*
+     * The rows of the dangling vertices, from the iterate the last
+     * iteration started with, add up to the lumped pagerank of the last
+     * iteration.
+     */
+    if (num_iterations > 0) {
+        size_t num_dangling_blocks =
+            (num_dangling + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+#pragma omp parallel num_threads(num_threads)
+        {
+            vector<double> h(REDUCE_BLOCK);
+#pragma omp for schedule(dynamic, 16)
+            for (size_t b = 0; b < num_dangling_blocks; b++) {
+                size_t first = linked + b * REDUCE_BLOCK;
+                size_t last = min(first + REDUCE_BLOCK, num_rows);
+                kernel.gather_rows(contrib.data(), offsets, links, first,
+                                   last, h.data());
+                for (size_t i = first; i < last; i++) {
+                    pr[i] = alpha * h[i - first] + last_Av + one_Iv;
+                }
+            }
+        }
+    } else {
+        for (size_t i = linked; i < num_rows; i++) {
+            pr[i] = dangling_pr / num_dangling;
+        }
+    }
+    for (size_t i = 0; i < num_rows; i++) {
+        pr[i] /= sum_pr;
+    }
+    stats.add_phase("recover", recover);
+
+    cerr << "lumped power solver finished after " << num_iterations
+         << " iterations, diff = " << diff << ", "
+         << elapsed * 1000 / max(num_iterations, 1UL)
+         << " ms per iteration, " << linked << " of " << num_rows
+         << " vertices iterated" << endl;
+}
+
+template void Table::iterate_lumped<uint32_t, float>(const uint32_t *);
+template void Table::iterate_lumped<uint32_t, double>(const uint32_t *);
+template void Table::iterate_lumped<size_t, float>(const size_t *);
+template void Table::iterate_lumped<size_t, double>(const size_t *);
@@ -0,0 +1,114 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MAPPED_ARRAY_H
+#define MAPPED_ARRAY_H
+
+#include <vector>
+#include <cstddef>
+
+/*
+ * A read-only memory mapping of a file, unmapped on destruction.
+ */
+class FileMapping {
+private:
+    void *addr;
+    size_t length;
+
+    FileMapping(const FileMapping &);
+    FileMapping &operator=(const FileMapping &);
+
+public:
+    FileMapping(void *a, size_t l) : addr(a), length(l) { }
+    ~FileMapping();
+
+    const char *data() const { return (const char *) addr; }
+    size_t size() const { return length; }
+};
+
+/*
+ * An array whose elements either live in a vector it owns or in memory
+ * owned by someone else, typically a FileMapping. Read access is the
+ * same in both cases; edit() returns the vector, first copying the
+ * elements into it if they were external, so external memory is never
+ * written to.
+ */
+template <class T>
+class MappedArray {
+private:
+    std::vector<T> owned;
+    const T *ext; // external elements, or NULL if the vector is used
+    size_t ext_size;
+
+public:
+    MappedArray() : ext(NULL), ext_size(0) { }
+
+    /*
+     * Refers to the n elements at p instead of the owned ones. The
+     * memory must outlive the array, or the next call to edit() or
+     * clear().
+     */
+    void attach(const T *p, size_t n) {
+        std::vector<T>().swap(owned);
+        ext = p;
+        ext_size = n;
+    }
+
+    bool is_mapped() const { return ext != NULL; }
+
+    std::vector<T> &edit() {
+        if (ext != NULL) {
+            owned.assign(ext, ext + ext_size);
+            ext = NULL;
+            ext_size = 0;
+        }
+        return owned;
+    }
+
+    void clear() {
+        ext = NULL;
+        ext_size = 0;
+        owned.clear();
+    }
+
+    size_t size() const { return ext ? ext_size : owned.size(); }
+    bool empty() const { return size() == 0; }
+    const T *data() const { return ext ? ext : owned.data(); }
+    const T *begin() const { return data(); }
+    const T *end() const { return data() + size(); }
+    const T &operator[](size_t i) const { return data()[i]; }
+    const T &back() const { return data()[size() - 1]; }
+};
+
+#endif
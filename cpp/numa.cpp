@@ -0,0 +1,164 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdint>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "numa.h"
+
+using namespace std;
+
+/* From <linux/mempolicy.h>, which glibc does not include */
+static const int MPOL_PREFERRED = 1;
+static const unsigned MPOL_MF_MOVE = 1 << 1;
+
+/* Nodes are numbered below this in sysfs */
+static const int MAX_NUMA_NODES = 1024;
+
+/*
+ * Sets cpus to those in a sysfs CPU list such as "0-3,8,10-11".
+ */
+static void parse_cpu_list(const string &list, vector<int> &cpus) {
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ',')) {
+        int first, last;
+        char dash;
+        stringstream rs(range);
+        if (!(rs >> first)) {
+            continue;
+        }
+        last = (rs >> dash >> last) ? last : first;
+        for (int c = first; c <= last; c++) {
+            cpus.push_back(c);
+        }
+    }
+}
+
+NumaTopology::NumaTopology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_mask = (sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+
+    for (int id = 0; id < MAX_NUMA_NODES; id++) {
+        ifstream in("/sys/devices/system/node/node" + to_string(id)
+                    + "/cpulist");
+        string list;
+        if (!in || !getline(in, list)) {
+            continue;
+        }
+        vector<int> all, node;
+        parse_cpu_list(list, all);
+        for (int c : all) {
+            if (!have_mask || (c < CPU_SETSIZE && CPU_ISSET(c, &allowed))) {
+                node.push_back(c);
+            }
+        }
+        /* Nodes with memory only are left to the kernel */
+        if (!node.empty()) {
+            ids.push_back(id);
+            cpus.push_back(node);
+        }
+    }
+
+    if (ids.empty()) {
+        vector<int> node;
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (have_mask ? CPU_ISSET(c, &allowed) : c == 0) {
+                node.push_back(c);
+            }
+        }
+        ids.push_back(0);
+        cpus.push_back(node);
+    }
+}
+
+const NumaTopology &NumaTopology::get() {
+    static const NumaTopology topology;
+    return topology;
+}
+
+size_t NumaTopology::thread_node(size_t t, size_t size) const {
+    return t * ids.size() / size;
+}
+
+int NumaTopology::thread_cpu(size_t t, size_t size) const {
+    size_t n = thread_node(t, size);
+    /* The first thread of node n */
+    size_t first = (n * size + ids.size() - 1) / ids.size();
+    return cpus[n][(t - first) % cpus[n].size()];
+}
+
+bool pin_thread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+void unpin_thread() {
+    const NumaTopology &topology = NumaTopology::get();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t n = 0; n < topology.num_nodes(); n++) {
+        for (int c : topology.node_cpus(n)) {
+            CPU_SET(c, &set);
+        }
+    }
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+bool move_to_node(const void *p, size_t bytes, int node) {
+#ifdef SYS_mbind
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t) p + page - 1) / page * page;
+    uintptr_t end = ((uintptr_t) p + bytes + page - 1) / page * page;
+    if (bytes == 0 || start >= end) {
+        return true;
+    }
+    const size_t word = 8 * sizeof(unsigned long);
+    vector<unsigned long> mask(node / word + 1, 0);
+    mask[node / word] = 1UL << (node % word);
+    return syscall(SYS_mbind, start, end - start, MPOL_PREFERRED,
+                   mask.data(), mask.size() * word + 1, MPOL_MF_MOVE) == 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,104 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <vector>
+#include <cstddef>
+
+/*
+ * The NUMA nodes of the machine that have CPUs this process may run
+ * on, with those CPUs, as listed in sysfs. Without NUMA support in the
+ * kernel the machine is taken as a single node 0 with all the CPUs.
+ */
+class NumaTopology {
+private:
+    std::vector<int> ids; // the number of each node in sysfs
+    std::vector<std::vector<int> > cpus; // the allowed CPUs of each node
+
+    NumaTopology();
+
+public:
+    /*
+     * Returns the topology, read from sysfs the first time.
+     */
+    static const NumaTopology &get();
+
+    size_t num_nodes() const { return ids.size(); }
+
+    /*
+     * Returns the number of node n (counted from 0) in sysfs.
+     */
+    int node_id(size_t n) const { return ids[n]; }
+
+    /*
+     * Returns the CPUs of node n.
+     */
+    const std::vector<int> &node_cpus(size_t n) const { return cpus[n]; }
+
+    /*
+     * Returns the node of thread t of a team of size threads: the team
+     * is split into one run of consecutive threads per node, so that
+     * threads working on neighbouring rows share a node.
+     */
+    size_t thread_node(size_t t, size_t size) const;
+
+    /*
+     * Returns the CPU for thread t of a team of size threads, one of
+     * those of its node, in turn.
+     */
+    int thread_cpu(size_t t, size_t size) const;
+};
+
+/*
+ * Pins the calling thread to cpu. Returns false if that is not allowed.
+ */
+bool pin_thread(int cpu);
+
+/*
+ * Lets the calling thread run on any of the CPUs of the topology again.
+ */
+void unpin_thread();
+
+/*
+ * Moves the pages that start within the bytes bytes from p to the NUMA
+ * node with the given number, and has any of them that are not yet
+ * allocated allocated there. When adjacent ranges are placed this way,
+ * each page goes to the node of the range it starts in. Returns false
+ * if the kernel does not support it.
+ */
+bool move_to_node(const void *p, size_t bytes, int node);
+
+#endif
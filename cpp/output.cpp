@@ -0,0 +1,241 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <charconv>
+#include <functional>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+
+#include "table.h"
+#include "openmp.h"
+
+/* Lines formatted by a thread before they are written out */
+static const size_t OUTPUT_CHUNK = 1 << 16;
+
+/*
+ * Layout of a binary pagerank file: a header, followed by the pagerank
+ * of every vertex as a float or double array, and then the vertex IDs,
+ * if the vertices are not numbered 0..n-1 in the graph file: the
+ * original 64-bit IDs of renumbered numeric vertices, or the offsets
+ * (num_names + 1 of them) and the bytes of the string names, back to
+ * back. All values are in the byte order of the machine that wrote
+ * the file, which is recorded in the header.
+ */
+static const char RANKS_MAGIC[8] = { 'P', 'R', 'R', 'A', 'N', 'K', 'S', 0 };
+static const uint32_t RANKS_VERSION = 1;
+static const uint32_t RANKS_BYTE_ORDER = 0x01020304;
+static const uint32_t RANKS_NUMERIC = 1;
+static const uint32_t RANKS_REMAP = 2;
+
+struct RanksHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t value_size; // 4 for float, 8 for double ranks
+    uint32_t flags;
+    uint64_t num_rows;
+    uint64_t num_names;
+    uint64_t names_bytes;
+};
+
+void Table::append_node_name(string &out, size_t i) {
+    char buf[24];
+    if (numeric) {
+        uint64_t id = remap ? node_ids[i] : i;
+        out.append(buf, to_chars(buf, buf + sizeof(buf), id).ptr);
+    } else if (i < node_names.size()) {
+        string_view name = node_names[i];
+        out.append(name.data(), name.size());
+    }
+}
+
+/*
+ * Formats r as cout does with the precision set to digits10, the way
+ * the ranks have always been printed, but several times faster.
+ */
+void Table::append_rank(string &out, double r) {
+    char buf[32];
+    out.append(buf, to_chars(buf, buf + sizeof(buf), r, chars_format::general,
+                             numeric_limits<double>::digits10).ptr);
+}
+
+void Table::write_lines(size_t n,
+                        const function<void(size_t, string &)> &format) {
+
+    size_t nthreads = min(num_threads, (n + OUTPUT_CHUNK - 1) / OUTPUT_CHUNK);
+    vector<string> chunks(max(nthreads, (size_t) 1));
+    cout.flush();
+    for (size_t first = 0; first < n; first += chunks.size() * OUTPUT_CHUNK) {
+#pragma omp parallel for num_threads(chunks.size()) schedule(static, 1)
+        for (size_t c = 0; c < chunks.size(); c++) {
+            string &out = chunks[c];
+            out.clear();
+            size_t begin = min(first + c * OUTPUT_CHUNK, n);
+            size_t end = min(begin + OUTPUT_CHUNK, n);
+            for (size_t i = begin; i < end; i++) {
+                format(i, out);
+            }
+        }
+        for (const string &out : chunks) {
+            cout.write(out.data(), out.size());
+        }
+    }
+    cout.flush();
+}
+
+const void Table::print_pagerank_v() {
+
+    size_t num_rows = pr.size();
+    double sum = 0;
+
+    for (size_t i = 0; i < num_rows; i++) {
+        sum += pr[i];
+    }
+    write_lines(num_rows, [this](size_t i, string &out) {
+        append_node_name(out, i);
+        out += " = ";
+        append_rank(out, pr[i]);
+        out += '\n';
+    });
+    cerr << "s = " << sum << " " << endl;
+}
+
+const void Table::print_ranked(const vector<pair<size_t, double> > &ranked) {
+
+    write_lines(ranked.size(), [this, &ranked](size_t i, string &out) {
+        append_node_name(out, ranked[i].first);
+        out += " = ";
+        append_rank(out, ranked[i].second);
+        out += '\n';
+    });
+}
+
+void Table::top_pagerank(size_t k, vector<pair<size_t, double> > &top) {
+
+    top.clear();
+    size_t n = pr.size();
+    k = min(k, n);
+    if (k == 0) {
+        return;
+    }
+
+    /*
+     * Every thread keeps the k highest ranks of its part of the vertices
+     * in a heap whose top is the lowest of them, so most vertices cost a
+     * single comparison; the candidates of all threads are then sorted.
+     */
+    vector<vector<pair<size_t, double> > > heaps(num_threads);
+#pragma omp parallel num_threads(num_threads)
+    {
+        vector<pair<size_t, double> > &heap = heaps[omp_get_thread_num()];
+        heap.reserve(k);
+#pragma omp for schedule(static)
+        for (size_t i = 0; i < n; i++) {
+            pair<size_t, double> v(i, pr[i]);
+            if (heap.size() < k) {
+                heap.push_back(v);
+                push_heap(heap.begin(), heap.end(), higher_rank);
+            } else if (higher_rank(v, heap.front())) {
+                pop_heap(heap.begin(), heap.end(), higher_rank);
+                heap.back() = v;
+                push_heap(heap.begin(), heap.end(), higher_rank);
+            }
+        }
+    }
+    for (const vector<pair<size_t, double> > &heap : heaps) {
+        top.insert(top.end(), heap.begin(), heap.end());
+    }
+    partial_sort(top.begin(), top.begin() + k, top.end(), higher_rank);
+    top.resize(k);
+}
+
+int Table::save_pagerank_binary(const string &filename, bool single) {
+
+    ofstream out(filename.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out.is_open()) {
+        error("Cannot open file", filename.c_str());
+    }
+
+    size_t num_rows = pr.size();
+    bool named = !numeric && node_names.size() > 0;
+    RanksHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RANKS_MAGIC, sizeof(header.magic));
+    header.version = RANKS_VERSION;
+    header.byte_order = RANKS_BYTE_ORDER;
+    header.value_size = single ? sizeof(float) : sizeof(double);
+    header.flags = (numeric ? RANKS_NUMERIC : 0)
+        | (numeric && remap ? RANKS_REMAP : 0);
+    header.num_rows = num_rows;
+    header.num_names = named ? node_names.size() : 0;
+    header.names_bytes = named
+        ? node_names.get_offsets()[node_names.size()] : 0;
+    out.write((const char *) &header, sizeof(header));
+
+    if (single) {
+        vector<float> values(min(num_rows, OUTPUT_CHUNK));
+        for (size_t first = 0; first < num_rows; first += OUTPUT_CHUNK) {
+            size_t n = min(OUTPUT_CHUNK, num_rows - first);
+            for (size_t i = 0; i < n; i++) {
+                values[i] = (float) pr[first + i];
+            }
+            out.write((const char *) values.data(), n * sizeof(float));
+        }
+    } else {
+        out.write((const char *) pr.data(), num_rows * sizeof(double));
+    }
+    if (numeric && remap) {
+        out.write((const char *) node_ids.data(), num_rows * sizeof(uint64_t));
+    }
+    if (named) {
+        out.write((const char *) node_names.get_offsets().data(),
+                  (header.num_names + 1) * sizeof(size_t));
+        out.write(node_names.get_arena().data(), header.names_bytes);
+    }
+    out.close();
+    if (out.fail()) {
+        error("Cannot write file", filename.c_str());
+    }
+
+    cerr << "wrote the pagerank of " << num_rows << " vertices to "
+         << filename << endl;
+
+    return 0;
+}
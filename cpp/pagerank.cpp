@@ -40,21 +40,75 @@
 using namespace std;
 
 #include "table.h"
+#include "transport.h"
 
 const char *TRACE_ARG = "-t";
+const char *VERBOSE_ARG = "-v";
 const char *NUMERIC_ARG = "-n";
+const char *REMAP_ARG = "-r";
 const char *ALPHA_ARG = "-a";
 const char *CONVERGENCE_ARG = "-c";
 const char *SIZE_ARG = "-s";
 const char *DELIM_ARG = "-d";
 const char *ITER_ARG = "-m";
+const char *THREADS_ARG = "-T";
+const char *SAVE_BINARY_ARG = "--save-binary";
+const char *LOAD_BINARY_ARG = "--load-binary";
+const char *VERIFY_ARG = "--verify";
+const char *SAVE_SHARDS_ARG = "--save-shards";
+const char *LOAD_SHARDS_ARG = "--load-shards";
+const char *SHARD_ROWS_ARG = "--shard-rows=";
+const char *WORKERS_ARG = "--workers=";
+const char *TRANSPORT_ARG = "--transport=";
+const char *WORKER_ARG = "--worker=";
+const char *PEERS_ARG = "--peers=";
+const char *SOLVER_ARG = "--solver=";
+const char *OMEGA_ARG = "--omega=";
+const char *EXTRAPOLATE_ARG = "--extrapolate=";
+const char *EXTRAPOLATE_EVERY_ARG = "--extrapolate-every=";
+const char *LUMP_DANGLING_ARG = "--lump-dangling";
+const char *KERNEL_ARG = "--kernel=";
+const char *NUMA_ARG = "--numa";
+const char *NUMA_REPLICATE_ARG = "--numa-replicate";
+const char *FLOAT_ARG = "--float";
+const char *COMPRESS_ARG = "--compress";
+const char *REORDER_ARG = "--reorder=";
+const char *UPDATE_ARG = "--update";
+const char *SEEDS_ARG = "--seeds";
+const char *LOCAL_ARG = "--local=";
+const char *EPSILON_ARG = "--epsilon=";
+const char *TOP_ARG = "--top=";
+const char *STATS_ARG = "--stats=";
+const char *PERF_ARG = "--perf";
+const char *OUTPUT_BINARY_ARG = "--output-binary";
+const char *OUTPUT_FLOAT_ARG = "--output-float";
 
 void usage() {
-    cerr << "pagerank [-tn] [-a alpha ] [-s size] [-d delim] "
-         << "[-m max_iterations] <graph_file>" << endl
+    cerr << "pagerank [-tvnr] [-a alpha ] [-s size] [-d delim] "
+         << "[-m max_iterations] [-T threads] "
+         << "[--solver=power|gs|sor] [--omega=omega] "
+         << "[--extrapolate=quadratic [--extrapolate-every=n]] "
+         << "[--lump-dangling] "
+         << "[--kernel=auto|pull|push] [--numa] [--numa-replicate] "
+         << "[--float] [--compress] "
+         << "[--reorder=degree|rcm|gorder|dangling] "
+         << "[--update changes] [--seeds seed_sets] "
+         << "[--local=seed [--epsilon=epsilon]] [--top=k] "
+         << "[--output-binary file [--output-float]] "
+         << "[--save-binary snapshot] [--stats=json] [--perf] <graph_file>" << endl
+         << "pagerank [options] [--verify] --load-binary snapshot" << endl
+         << "pagerank [options] [--shard-rows=rows] --save-shards directory "
+         << "<graph_file>" << endl
+         << "pagerank [options] --load-shards directory" << endl
+         << "    with [--workers=n [--transport=shm|unix|tcp]] or "
+         << "[--worker=rank --peers=address,...]" << endl
          << " -t enable tracing " << endl
+         << " -v log the difference between successive iterations" << endl
          << " -n treat graph file as numeric; i.e. input comprises "
          << "integer vertex names" << endl
+         << " -r treat graph file as numeric, with arbitrary 64-bit "
+         << "integer vertex names" << endl
+         << "    that are renumbered densely" << endl
          << " -a alpha" << endl
          << "    the dumping factor " << endl
          << " -c convergence" << endl
@@ -65,7 +119,107 @@ void usage() {
          << "    delimiter for separating vertex names in each input"
          << "line " << endl
          << " -m max_iterations" << endl
-         << "    maximum number of iterations to perform" << endl;
+         << "    maximum number of iterations to perform" << endl
+         << " -T threads" << endl
+         << "    number of threads for the pagerank calculation" << endl
+         << " --solver=power|gs|sor" << endl
+         << "    power method, Gauss-Seidel or successive over-relaxation"
+         << endl
+         << " --omega=omega" << endl
+         << "    the relaxation factor for --solver=sor, between 0 and 2; "
+         << "only up to 1" << endl
+         << "    is convergence guaranteed" << endl
+         << " --extrapolate=quadratic" << endl
+         << "    accelerate the power method by extrapolating from the "
+         << "last iterates" << endl
+         << " --extrapolate-every=n" << endl
+         << "    the number of iterations between extrapolations" << endl
+         << " --lump-dangling" << endl
+         << "    iterate only over the vertices with out-links, lumping the "
+         << "dangling ones" << endl
+         << " --kernel=auto|pull|push" << endl
+         << "    gather along the in-links, or push along the out-links into "
+         << "cache-sized bins;" << endl
+         << "    auto pushes when the ranks do not fit in the last-level "
+         << "cache" << endl
+         << " --numa" << endl
+         << "    pin the threads and move the rows each iterates over to the "
+         << "memory of its node" << endl
+         << " --numa-replicate" << endl
+         << "    as --numa, with a copy of the contributions on every node"
+         << endl
+         << " --reorder=degree|rcm|gorder|dangling" << endl
+         << "    renumber the vertices for locality before the calculation"
+         << endl
+         << " --float" << endl
+         << "    iterate with single precision ranks" << endl
+         << " --compress" << endl
+         << "    keep the in-links compressed during the calculation" << endl
+         << " --update changes" << endl
+         << "    add (+) and remove (-) the arcs in changes after the "
+         << "calculation" << endl
+         << "    and update the pagerank incrementally" << endl
+         << " --seeds seed_sets" << endl
+         << "    calculate the personalized pagerank of each line of "
+         << "seed_sets," << endl
+         << "    which lists vertices separated by the delimiter" << endl
+         << " --local=seed" << endl
+         << "    approximate the personalized pagerank of seed locally"
+         << endl
+         << " --epsilon=epsilon" << endl
+         << "    the residual tolerance for --local" << endl
+         << " --top=k" << endl
+         << "    output only the k vertices with the highest pagerank"
+         << endl
+         << " --output-binary file" << endl
+         << "    write the pagerank to file in binary instead of to stdout"
+         << endl
+         << " --output-float" << endl
+         << "    write single rather than double precision ranks with "
+         << "--output-binary" << endl
+         << " --stats=json" << endl
+         << "    write the time and memory of each phase and the progress "
+         << "of each" << endl
+         << "    iteration to stderr as JSON at the end" << endl
+         << " --perf" << endl
+         << "    count cycles, instructions and cache, TLB and branch "
+         << "misses in each" << endl
+         << "    phase and iteration, and write them to stderr at the end"
+         << endl
+         << " --save-binary snapshot" << endl
+         << "    write the graph to a binary snapshot file and exit" << endl
+         << " --load-binary snapshot" << endl
+         << "    read the graph from a binary snapshot file" << endl
+         << " --verify" << endl
+         << "    verify the checksums of a snapshot while loading it" << endl
+         << " --save-shards directory" << endl
+         << "    write the graph to shards in directory without holding it "
+         << "in memory," << endl
+         << "    and calculate the pagerank from them" << endl
+         << " --load-shards directory" << endl
+         << "    calculate the pagerank from the shards in directory" << endl
+         << " --shard-rows=rows" << endl
+         << "    the number of vertices whose in-links go in each shard"
+         << endl
+         << " --workers=n" << endl
+         << "    calculate from the shards with n worker processes" << endl
+         << " --transport=shm|unix|tcp" << endl
+         << "    how the worker processes exchange ranks" << endl
+         << " --worker=rank" << endl
+         << "    run as worker rank of the workers listening at --peers"
+         << endl
+         << " --peers=address,..." << endl
+         << "    the host:port or Unix socket path of every worker, "
+         << "in order" << endl;
+}
+
+/*
+ * Returns the value of an argument of the form "--name=value", given
+ * the prefix "--name=", or NULL if arg does not start with the prefix.
+ */
+const char *long_arg(const char *arg, const char *prefix) {
+    size_t len = strlen(prefix);
+    return strncmp(arg, prefix, len) ? NULL : arg + len;
 }
 
 int check_inc(int i, int max) {
@@ -80,14 +234,40 @@ int main(int argc, char **argv) {
 
     Table t;
     char *endptr;
+    const char *value;
     string input = "stdin";
+    string save_binary;
+    string load_binary;
+    string save_shards;
+    string load_shards;
+    size_t shard_rows = DEFAULT_SHARD_ROWS;
+    size_t workers = 0;
+    TransportKind transport = TRANSPORT_SHM;
+    const char *worker = NULL;
+    vector<string> peers;
+    string update;
+    string seeds;
+    const char *local = NULL;
+    double epsilon = DEFAULT_EPSILON;
+    size_t top = 0;
+    bool verify = false;
+    bool stats = false;
+    bool perf = false;
+    string output_binary;
+    bool output_float = false;
+    Reorder reorder = REORDER_NONE;
 
     int i = 1;
     while (i < argc) {
         if (!strcmp(argv[i], TRACE_ARG)) {
             t.set_trace(true);
+        } else if (!strcmp(argv[i], VERBOSE_ARG)) {
+            t.set_verbose(true);
         } else if (!strcmp(argv[i], NUMERIC_ARG)) {
             t.set_numeric(true);
+        } else if (!strcmp(argv[i], REMAP_ARG)) {
+            t.set_numeric(true);
+            t.set_remap(true);
         } else if (!strcmp(argv[i], ALPHA_ARG)) {
             i = check_inc(i, argc);
             double alpha = strtod(argv[i], &endptr);
@@ -120,6 +300,138 @@ int main(int argc, char **argv) {
                 exit(1);
             }
             t.set_max_iterations(iterations);
+        } else if (!strcmp(argv[i], THREADS_ARG)) {
+            i = check_inc(i, argc);
+            size_t threads = strtol(argv[i], &endptr, 10);
+            if (threads == 0 && endptr) {
+                cerr << "Invalid threads argument" << endl;
+                exit(1);
+            }
+            t.set_num_threads(threads);
+        } else if ((value = long_arg(argv[i], SOLVER_ARG))) {
+            Solver solver;
+            if (!parse_solver(value, solver)) {
+                cerr << "Invalid solver argument" << endl;
+                exit(1);
+            }
+            t.set_solver(solver);
+        } else if ((value = long_arg(argv[i], OMEGA_ARG))) {
+            double omega = strtod(value, &endptr);
+            if (omega <= 0 || omega >= 2 || *endptr) {
+                cerr << "Invalid omega argument" << endl;
+                exit(1);
+            }
+            t.set_omega(omega);
+        } else if (!strcmp(argv[i], LUMP_DANGLING_ARG)) {
+            t.set_lump_dangling(true);
+        } else if ((value = long_arg(argv[i], KERNEL_ARG))) {
+            IterationKernel kernel;
+            if (!parse_kernel(value, kernel)) {
+                cerr << "Invalid kernel argument" << endl;
+                exit(1);
+            }
+            t.set_iteration_kernel(kernel);
+        } else if (!strcmp(argv[i], NUMA_ARG)) {
+            t.set_numa(true);
+        } else if (!strcmp(argv[i], NUMA_REPLICATE_ARG)) {
+            t.set_numa_replicate(true);
+        } else if ((value = long_arg(argv[i], EXTRAPOLATE_EVERY_ARG))) {
+            size_t period = strtol(value, &endptr, 10);
+            if (period == 0 || *endptr) {
+                cerr << "Invalid extrapolation period argument" << endl;
+                exit(1);
+            }
+            t.set_extrapolation_period(period);
+        } else if ((value = long_arg(argv[i], EXTRAPOLATE_ARG))) {
+            Extrapolation extrapolation;
+            if (!parse_extrapolation(value, extrapolation)) {
+                cerr << "Invalid extrapolate argument" << endl;
+                exit(1);
+            }
+            t.set_extrapolation(extrapolation);
+        } else if ((value = long_arg(argv[i], REORDER_ARG))) {
+            if (!parse_reorder(value, reorder)) {
+                cerr << "Invalid reorder argument" << endl;
+                exit(1);
+            }
+        } else if (!strcmp(argv[i], FLOAT_ARG)) {
+            t.set_float_ranks(true);
+        } else if (!strcmp(argv[i], COMPRESS_ARG)) {
+            t.set_compress(true);
+        } else if (!strcmp(argv[i], SAVE_BINARY_ARG)) {
+            i = check_inc(i, argc);
+            save_binary = argv[i];
+        } else if (!strcmp(argv[i], LOAD_BINARY_ARG)) {
+            i = check_inc(i, argc);
+            load_binary = argv[i];
+        } else if (!strcmp(argv[i], SAVE_SHARDS_ARG)) {
+            i = check_inc(i, argc);
+            save_shards = argv[i];
+        } else if (!strcmp(argv[i], LOAD_SHARDS_ARG)) {
+            i = check_inc(i, argc);
+            load_shards = argv[i];
+        } else if ((value = long_arg(argv[i], SHARD_ROWS_ARG))) {
+            shard_rows = strtol(value, &endptr, 10);
+            if (shard_rows == 0 || *endptr) {
+                cerr << "Invalid shard rows argument" << endl;
+                exit(1);
+            }
+        } else if ((value = long_arg(argv[i], WORKERS_ARG))) {
+            workers = strtol(value, &endptr, 10);
+            if (workers == 0 || *endptr) {
+                cerr << "Invalid workers argument" << endl;
+                exit(1);
+            }
+        } else if ((value = long_arg(argv[i], TRANSPORT_ARG))) {
+            if (!parse_transport(value, transport)) {
+                cerr << "Invalid transport argument" << endl;
+                exit(1);
+            }
+        } else if ((value = long_arg(argv[i], WORKER_ARG))) {
+            worker = value;
+        } else if ((value = long_arg(argv[i], PEERS_ARG))) {
+            string list = value;
+            size_t pos = 0;
+            while (pos <= list.size()) {
+                size_t comma = min(list.find(',', pos), list.size());
+                peers.push_back(list.substr(pos, comma - pos));
+                pos = comma + 1;
+            }
+        } else if (!strcmp(argv[i], UPDATE_ARG)) {
+            i = check_inc(i, argc);
+            update = argv[i];
+        } else if (!strcmp(argv[i], SEEDS_ARG)) {
+            i = check_inc(i, argc);
+            seeds = argv[i];
+        } else if ((value = long_arg(argv[i], LOCAL_ARG))) {
+            local = value;
+        } else if ((value = long_arg(argv[i], EPSILON_ARG))) {
+            epsilon = strtod(value, &endptr);
+            if (epsilon <= 0 || *endptr) {
+                cerr << "Invalid epsilon argument" << endl;
+                exit(1);
+            }
+        } else if ((value = long_arg(argv[i], TOP_ARG))) {
+            top = strtol(value, &endptr, 10);
+            if (top == 0 || *endptr) {
+                cerr << "Invalid top argument" << endl;
+                exit(1);
+            }
+        } else if ((value = long_arg(argv[i], STATS_ARG))) {
+            if (strcmp(value, "json")) {
+                cerr << "Invalid stats argument" << endl;
+                exit(1);
+            }
+            stats = true;
+        } else if (!strcmp(argv[i], PERF_ARG)) {
+            perf = true;
+        } else if (!strcmp(argv[i], OUTPUT_BINARY_ARG)) {
+            i = check_inc(i, argc);
+            output_binary = argv[i];
+        } else if (!strcmp(argv[i], OUTPUT_FLOAT_ARG)) {
+            output_float = true;
+        } else if (!strcmp(argv[i], VERIFY_ARG)) {
+            verify = true;
         } else if (!strcmp(argv[i], DELIM_ARG)) {
             i = check_inc(i, argc);
             t.set_delim(argv[i]);
@@ -132,15 +444,140 @@ int main(int argc, char **argv) {
         i++;
     }
 
+    /* Before any thread is started, so that all of them are counted */
+    if (perf && t.enable_perf_counters() == 0) {
+        cerr << "Hardware counters are unavailable, continuing without them"
+             << endl;
+        perf = false;
+    }
+    auto print_pagerank = [&]() {
+        if (!output_binary.empty()) {
+            t.save_pagerank_binary(output_binary, output_float);
+        } else if (top > 0) {
+            vector<pair<size_t, double> > ranked;
+            t.top_pagerank(top, ranked);
+            t.print_ranked(ranked);
+        } else {
+            t.print_pagerank_v();
+        }
+    };
+    auto print_stats = [&]() {
+        if (perf) {
+            t.get_stats().write_counters(cerr);
+        }
+        if (stats) {
+            t.get_stats().write_json(cerr);
+        }
+    };
+
     t.print_params(cerr);
-    cerr << "Reading input from " << input << "..." << endl;
-    if (!strcmp(input.c_str(), "stdin")) {
-            t.read_file("");
+    if (!save_shards.empty() || !load_shards.empty()) {
+        /* Nothing but the pagerank itself is calculated out of core */
+        if (reorder != REORDER_NONE || !save_binary.empty()
+            || !load_binary.empty() || !update.empty() || !seeds.empty()
+            || local) {
+            usage();
+            exit(1);
+        }
+        if (!load_shards.empty()) {
+            cerr << "Loading shards from " << load_shards << "..." << endl;
+            t.load_shards(load_shards);
+        } else {
+            cerr << "Sharding input from " << input << " into "
+                 << save_shards << "..." << endl;
+            t.shard_file(input == "stdin" ? "" : input, save_shards,
+                         shard_rows);
+        }
+        if (worker || workers > 0) {
+            auto calculate = [&](Transport &transport) {
+                t.distributed_pagerank(transport);
+                if (transport.rank() == 0) {
+                    cerr << "Done calculating!" << endl;
+                    print_pagerank();
+                    print_stats();
+                }
+            };
+            if (worker) {
+                size_t rank = strtol(worker, &endptr, 10);
+                if (*endptr || rank >= peers.size()) {
+                    cerr << "Invalid worker argument" << endl;
+                    exit(1);
+                }
+                cerr << "Calculating pagerank as worker " << rank << " of "
+                     << peers.size() << "..." << endl;
+                SocketTransport sockets(rank, peers);
+                calculate(sockets);
+            } else {
+                cerr << "Calculating pagerank on " << workers << " "
+                     << transport_name(transport) << " workers..." << endl;
+                if (!run_workers(workers, transport, calculate)) {
+                    cerr << "A worker failed" << endl;
+                    exit(1);
+                }
+            }
+            return 0;
+        }
+        cerr << "Calculating pagerank out of core..." << endl;
+        t.pagerank();
+        cerr << "Done calculating!" << endl;
+        print_pagerank();
+        print_stats();
+        return 0;
+    }
+    if (!load_binary.empty()) {
+        cerr << "Loading snapshot from " << load_binary << "..." << endl;
+        t.load_binary(load_binary, verify);
     } else {
-        t.read_file(input);
+        cerr << "Reading input from " << input << "..." << endl;
+        if (!strcmp(input.c_str(), "stdin")) {
+            t.read_file("");
+        } else {
+            t.read_file(input);
+        }
+    }
+    if (reorder != REORDER_NONE) {
+        cerr << "Reordering vertices..." << endl;
+        t.reorder_vertices(reorder);
+    }
+    if (!save_binary.empty()) {
+        t.save_binary(save_binary);
+        print_stats();
+        return 0;
+    }
+    if (local) {
+        size_t seed = t.find_vertex(local);
+        if (seed == IdMap::NOT_FOUND) {
+            cerr << "Unknown seed vertex " << local << endl;
+            exit(1);
+        }
+        vector<pair<size_t, double> > ranked;
+        cerr << "Calculating local pagerank of " << local << "..." << endl;
+        t.local_pagerank(seed, epsilon, top, ranked);
+        cerr << "Done calculating!" << endl;
+        t.print_ranked(ranked);
+        print_stats();
+        return 0;
+    }
+    if (!seeds.empty()) {
+        vector<vector<pair<size_t, double> > > teleport;
+        t.read_seeds(seeds, teleport);
+        cerr << "Calculating personalized pagerank for " << teleport.size()
+             << " seed sets..." << endl;
+        t.personalized_pagerank(teleport);
+        cerr << "Done calculating!" << endl;
+        t.print_personalized_v();
+        print_stats();
+        return 0;
     }
     cerr << "Calculating pagerank..." << endl;
     t.pagerank();
     cerr << "Done calculating!" << endl;
-    t.print_pagerank_v();
+    if (!update.empty()) {
+        cerr << "Applying changes from " << update << "..." << endl;
+        t.read_changes(update);
+        t.update_pagerank();
+        cerr << "Done updating!" << endl;
+    }
+    print_pagerank();
+    print_stats();
 }
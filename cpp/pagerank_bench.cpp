@@ -0,0 +1,773 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <random>
+#include <chrono>
+#include <charconv>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include "table.h"
+
+using namespace std;
+
+const char *GRAPHS_ARG = "--graphs=";
+const char *VERTICES_ARG = "--vertices=";
+const char *DEGREE_ARG = "--degree=";
+const char *SEED_ARG = "--seed=";
+const char *RUNS_ARG = "--runs=";
+const char *WARMUP_ARG = "--warmup=";
+const char *THREADS_ARG = "-T";
+const char *SOLVER_ARG = "--solver=";
+const char *EXTRAPOLATE_ARG = "--extrapolate=";
+const char *FLOAT_ARG = "--float";
+const char *COMPRESS_ARG = "--compress";
+const char *LUMP_DANGLING_ARG = "--lump-dangling";
+const char *KERNEL_ARG = "--kernel=";
+const char *NUMA_ARG = "--numa";
+const char *NUMA_REPLICATE_ARG = "--numa-replicate";
+const char *DIR_ARG = "--dir=";
+const char *OUTPUT_ARG = "--output=";
+const char *BASELINE_ARG = "--baseline=";
+const char *TOLERANCE_ARG = "--tolerance=";
+
+const size_t DEFAULT_VERTICES = 100000;
+const size_t DEFAULT_DEGREE = 16;
+const unsigned long DEFAULT_SEED = 1;
+const size_t DEFAULT_RUNS = 5;
+const size_t DEFAULT_WARMUP = 1;
+const double DEFAULT_TOLERANCE = 0.1;
+
+/*
+ * The phases of a calculation that are timed: reading the graph file,
+ * building the hyperlink matrix and iterating.
+ */
+const char *PHASES[] = { "load", "build", "iterate" };
+const size_t NUM_PHASES = 3;
+
+void usage() {
+    cerr << "pagerank_bench [--graphs=er,ba,rmat] [--vertices=n] "
+         << "[--degree=d] [--seed=s]" << endl
+         << "    [--runs=r] [--warmup=w] [-T threads] "
+         << "[--solver=power|gs|sor] [--float] [--compress]" << endl
+         << "    [--extrapolate=quadratic] [--lump-dangling] "
+         << "[--kernel=auto|pull|push]" << endl
+         << "    [--numa] [--numa-replicate] [--dir=directory] "
+         << "[--output=results.json]" << endl
+         << "    [--baseline=results.json [--tolerance=t]]" << endl
+         << " --graphs=er,ba,rmat" << endl
+         << "    the generated graphs to time: Erdos-Renyi, Barabasi-Albert "
+         << "and R-MAT" << endl
+         << " --vertices=n" << endl
+         << "    the number of vertices of each graph, rounded up to a power "
+         << "of two for R-MAT" << endl
+         << " --degree=d" << endl
+         << "    the average number of out-links of a vertex" << endl
+         << " --seed=s" << endl
+         << "    the seed of the random generators" << endl
+         << " --runs=r" << endl
+         << "    the number of timed runs of each graph" << endl
+         << " --warmup=w" << endl
+         << "    the number of runs of each graph before the timed ones"
+         << endl
+         << " --extrapolate=quadratic" << endl
+         << "    accelerate the power method, to compare the iterations and "
+         << "time" << endl
+         << "    with those of a run without" << endl
+         << " --lump-dangling" << endl
+         << "    iterate only over the vertices with out-links; the time to "
+         << "reorder" << endl
+         << "    the vertices for it counts as iterating" << endl
+         << " --kernel=auto|pull|push" << endl
+         << "    gather along the in-links or push into cache-sized bins; the "
+         << "time to" << endl
+         << "    bin the out-links for pushing counts as iterating" << endl
+         << " --numa, --numa-replicate" << endl
+         << "    place the iterations on the NUMA nodes, as for pagerank"
+         << endl
+         << " --dir=directory" << endl
+         << "    where the generated graph files are written" << endl
+         << " --output=results.json" << endl
+         << "    write the results there instead of to stdout" << endl
+         << " --baseline=results.json" << endl
+         << "    compare with earlier results and fail on regressions" << endl
+         << " --tolerance=t" << endl
+         << "    the slowdown in ns per edge taken as a regression; default "
+         << DEFAULT_TOLERANCE << endl;
+}
+
+/*
+ * Returns the value of an argument of the form "--name=value", given
+ * the prefix "--name=", or NULL if arg does not start with the prefix.
+ */
+const char *long_arg(const char *arg, const char *prefix) {
+    size_t len = strlen(prefix);
+    return strncmp(arg, prefix, len) ? NULL : arg + len;
+}
+
+size_t size_arg(const char *value, const char *what) {
+    char *endptr;
+    size_t n = strtoul(value, &endptr, 10);
+    if (*endptr || endptr == value) {
+        cerr << "Invalid " << what << " argument" << endl;
+        exit(1);
+    }
+    return n;
+}
+
+/*
+ * Writes arcs as lines of "<from> <to>", formatting them into a large
+ * buffer so that generating big graphs does not take longer than
+ * timing them.
+ */
+class ArcWriter {
+private:
+    FILE *file;
+    vector<char> buf;
+    size_t used;
+    size_t count;
+
+public:
+    ArcWriter(const string &filename) : buf(1 << 20), used(0), count(0) {
+        file = fopen(filename.c_str(), "w");
+        if (file == NULL) {
+            cerr << "Cannot open file " << filename << endl;
+            exit(1);
+        }
+    }
+
+    ~ArcWriter() {
+        fwrite(buf.data(), 1, used, file);
+        fclose(file);
+    }
+
+    void add(uint64_t from, uint64_t to) {
+        if (buf.size() - used < 48) {
+            fwrite(buf.data(), 1, used, file);
+            used = 0;
+        }
+        char *p = buf.data() + used;
+        char *end = buf.data() + buf.size();
+        p = to_chars(p, end, from).ptr;
+        *p++ = ' ';
+        p = to_chars(p, end, to).ptr;
+        *p++ = '\n';
+        used = p - buf.data();
+        count++;
+    }
+
+    size_t size() const { return count; }
+};
+
+/*
+ * Erdos-Renyi G(n, m): m = n * degree arcs between uniformly chosen
+ * distinct vertices.
+ */
+void generate_er(ArcWriter &out, size_t n, size_t degree, mt19937_64 &rng) {
+    uniform_int_distribution<uint64_t> vertex(0, n - 1);
+    for (size_t k = 0; k < n * degree; k++) {
+        uint64_t from = vertex(rng);
+        uint64_t to = vertex(rng);
+        while (to == from && n > 1) {
+            to = vertex(rng);
+        }
+        out.add(from, to);
+    }
+}
+
+/*
+ * Barabasi-Albert preferential attachment: every vertex links to degree
+ * earlier vertices, chosen with probability proportional to their
+ * number of links so far. Picking a uniform endpoint of the arcs made
+ * so far does exactly that.
+ */
+void generate_ba(ArcWriter &out, size_t n, size_t degree, mt19937_64 &rng) {
+    vector<uint64_t> ends;
+    ends.reserve(2 * n * degree);
+    for (uint64_t v = 1; v < n; v++) {
+        for (size_t k = 0; k < degree; k++) {
+            uint64_t to;
+            if (v <= degree) {
+                to = k % v;
+            } else {
+                to = ends[uniform_int_distribution<size_t>(
+                              0, ends.size() - 1)(rng)];
+            }
+            out.add(v, to);
+            ends.push_back(v);
+            ends.push_back(to);
+        }
+    }
+}
+
+/*
+ * R-MAT with the Graph500 parameters (a, b, c) = (0.57, 0.19, 0.19):
+ * each arc picks one quadrant of the adjacency matrix per bit of the
+ * vertex numbers. n must be a power of two.
+ */
+void generate_rmat(ArcWriter &out, size_t n, size_t degree,
+                   mt19937_64 &rng) {
+    const double a = 0.57;
+    const double b = 0.19;
+    const double c = 0.19;
+    uniform_real_distribution<double> coin(0, 1);
+    for (size_t k = 0; k < n * degree; k++) {
+        uint64_t from = 0;
+        uint64_t to = 0;
+        for (size_t bit = n >> 1; bit > 0; bit >>= 1) {
+            double r = coin(rng);
+            if (r >= a + b + c) {
+                from |= bit;
+                to |= bit;
+            } else if (r >= a + b) {
+                from |= bit;
+            } else if (r >= a) {
+                to |= bit;
+            }
+        }
+        out.add(from, to);
+    }
+}
+
+/*
+ * The times of the runs of one phase.
+ */
+struct Timings {
+    vector<double> seconds;
+
+    double mean() const {
+        double s = 0;
+        for (double t : seconds) {
+            s += t;
+        }
+        return s / seconds.size();
+    }
+
+    double stddev() const {
+        if (seconds.size() < 2) {
+            return 0;
+        }
+        double m = mean();
+        double s = 0;
+        for (double t : seconds) {
+            s += (t - m) * (t - m);
+        }
+        return sqrt(s / (seconds.size() - 1));
+    }
+
+    double min() const {
+        return *min_element(seconds.begin(), seconds.end());
+    }
+};
+
+struct Result {
+    string name;
+    string graph;
+    size_t vertices;
+    size_t arcs; // in the hyperlink matrix, duplicates dropped
+    size_t lines; // in the graph file
+    unsigned long seed;
+    unsigned long iterations;
+    Timings phases[NUM_PHASES];
+
+    /* The edges processed by a phase, for rates per edge */
+    double edges(size_t phase) const {
+        if (phase == 0) {
+            return lines;
+        }
+        return phase == 2 ? (double) arcs * max(iterations, 1UL) : arcs;
+    }
+};
+
+/*
+ * A minimal JSON reader, enough for reading back the results written
+ * by write_json().
+ */
+struct Json {
+    enum { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT } type;
+    double number;
+    string str;
+    vector<Json> items;
+    vector<pair<string, Json> > members;
+
+    const Json *get(const string &key) const {
+        for (const pair<string, Json> &m : members) {
+            if (m.first == key) {
+                return &m.second;
+            }
+        }
+        return NULL;
+    }
+};
+
+class JsonParser {
+private:
+    const string &text;
+    size_t pos;
+
+    void fail() {
+        cerr << "Invalid JSON at offset " << pos << endl;
+        exit(1);
+    }
+
+    void skip() {
+        while (pos < text.size() && isspace((unsigned char) text[pos])) {
+            pos++;
+        }
+    }
+
+    void expect(char c) {
+        skip();
+        if (pos >= text.size() || text[pos] != c) {
+            fail();
+        }
+        pos++;
+    }
+
+    string parse_string() {
+        expect('"');
+        string s;
+        while (pos < text.size() && text[pos] != '"') {
+            if (text[pos] == '\\' && pos + 1 < text.size()) {
+                pos++;
+            }
+            s += text[pos++];
+        }
+        expect('"');
+        return s;
+    }
+
+public:
+    JsonParser(const string &t) : text(t), pos(0) { }
+
+    Json parse() {
+        Json v;
+        skip();
+        if (pos >= text.size()) {
+            fail();
+        }
+        char c = text[pos];
+        if (c == '{') {
+            v.type = Json::OBJECT;
+            pos++;
+            skip();
+            if (text[pos] == '}') {
+                pos++;
+                return v;
+            }
+            do {
+                string key = parse_string();
+                expect(':');
+                v.members.push_back(make_pair(key, parse()));
+                skip();
+            } while (pos < text.size() && text[pos++] == ',');
+            if (text[pos - 1] != '}') {
+                fail();
+            }
+        } else if (c == '[') {
+            v.type = Json::ARRAY;
+            pos++;
+            skip();
+            if (text[pos] == ']') {
+                pos++;
+                return v;
+            }
+            do {
+                v.items.push_back(parse());
+                skip();
+            } while (pos < text.size() && text[pos++] == ',');
+            if (text[pos - 1] != ']') {
+                fail();
+            }
+        } else if (c == '"') {
+            v.type = Json::STRING;
+            v.str = parse_string();
+        } else if (text.compare(pos, 4, "true") == 0
+                   || text.compare(pos, 5, "false") == 0) {
+            v.type = Json::BOOL;
+            v.number = (c == 't');
+            pos += (c == 't') ? 4 : 5;
+        } else if (text.compare(pos, 4, "null") == 0) {
+            v.type = Json::NUL;
+            pos += 4;
+        } else {
+            v.type = Json::NUMBER;
+            char *end;
+            v.number = strtod(text.c_str() + pos, &end);
+            if (end == text.c_str() + pos) {
+                fail();
+            }
+            pos = end - text.c_str();
+        }
+        return v;
+    }
+};
+
+/*
+ * Writes a number as JSON, which has no infinities or NaNs.
+ */
+string json_number(double x) {
+    if (!isfinite(x)) {
+        return "null";
+    }
+    ostringstream s;
+    s.precision(6);
+    s << x;
+    return s.str();
+}
+
+/*
+ * A phase that got slower than in the baseline.
+ */
+struct Regression {
+    string name;
+    const char *phase;
+    double baseline;
+    double current; // ns per edge
+};
+
+void write_json(ostream &out, Table &t, size_t runs, size_t warmup,
+                const vector<Result> &results,
+                const vector<Regression> *regressions) {
+    out << "{" << endl
+        << "  \"threads\": " << t.get_num_threads() << "," << endl
+        << "  \"solver\": \"" << solver_name(t.get_solver()) << "\"," << endl
+        << "  \"extrapolation\": \""
+        << extrapolation_name(t.get_extrapolation()) << "\"," << endl
+        << "  \"ranks\": \"" << (t.get_float_ranks() ? "float" : "double")
+        << "\"," << endl
+        << "  \"compress\": " << (t.get_compress() ? "true" : "false")
+        << "," << endl
+        << "  \"lump_dangling\": "
+        << (t.get_lump_dangling() ? "true" : "false") << "," << endl
+        << "  \"kernel\": \"" << kernel_name(t.get_iteration_kernel())
+        << "\"," << endl
+        << "  \"numa\": " << (t.get_numa() ? "true" : "false") << ","
+        << endl
+        << "  \"numa_replicate\": "
+        << (t.get_numa_replicate() ? "true" : "false") << "," << endl
+        << "  \"runs\": " << runs << "," << endl
+        << "  \"warmup\": " << warmup << "," << endl
+        << "  \"benchmarks\": [";
+    for (size_t r = 0; r < results.size(); r++) {
+        const Result &res = results[r];
+        out << (r ? "," : "") << endl
+            << "    {" << endl
+            << "      \"name\": \"" << res.name << "\"," << endl
+            << "      \"graph\": \"" << res.graph << "\"," << endl
+            << "      \"vertices\": " << res.vertices << "," << endl
+            << "      \"arcs\": " << res.arcs << "," << endl
+            << "      \"lines\": " << res.lines << "," << endl
+            << "      \"seed\": " << res.seed << "," << endl
+            << "      \"iterations\": " << res.iterations;
+        for (size_t p = 0; p < NUM_PHASES; p++) {
+            const Timings &tm = res.phases[p];
+            double mean = tm.mean();
+            out << "," << endl
+                << "      \"" << PHASES[p] << "\": { "
+                << "\"mean_s\": " << json_number(mean)
+                << ", \"stddev_s\": " << json_number(tm.stddev())
+                << ", \"min_s\": " << json_number(tm.min())
+                << ", \"edges_per_s\": "
+                << json_number(res.edges(p) / mean)
+                << ", \"ns_per_edge\": "
+                << json_number(mean * 1e9 / res.edges(p)) << " }";
+        }
+        out << endl << "    }";
+    }
+    out << endl << "  ]";
+    if (regressions) {
+        out << "," << endl << "  \"regressions\": [";
+        for (size_t k = 0; k < regressions->size(); k++) {
+            const Regression &g = (*regressions)[k];
+            out << (k ? "," : "") << endl
+                << "    { \"name\": \"" << g.name << "\", \"phase\": \""
+                << g.phase << "\", \"baseline_ns_per_edge\": "
+                << json_number(g.baseline) << ", \"ns_per_edge\": "
+                << json_number(g.current) << ", \"change\": "
+                << json_number(g.current / g.baseline - 1) << " }";
+        }
+        out << endl << "  ]";
+    }
+    out << endl << "}" << endl;
+}
+
+/*
+ * Compares the results with those in the baseline file, by benchmark
+ * name and phase, and returns the phases whose ns per edge grew by
+ * more than tolerance.
+ */
+vector<Regression> compare(const string &filename,
+                           const vector<Result> &results, double tolerance) {
+    ifstream in(filename.c_str());
+    if (!in.is_open()) {
+        cerr << "Cannot open file " << filename << endl;
+        exit(1);
+    }
+    stringstream text;
+    text << in.rdbuf();
+    string s = text.str();
+    Json baseline = JsonParser(s).parse();
+    const Json *benchmarks = baseline.get("benchmarks");
+    if (baseline.type != Json::OBJECT || benchmarks == NULL) {
+        cerr << "No benchmarks in " << filename << endl;
+        exit(1);
+    }
+
+    vector<Regression> regressions;
+    for (const Result &res : results) {
+        const Json *old = NULL;
+        for (const Json &b : benchmarks->items) {
+            const Json *name = b.get("name");
+            if (name && name->str == res.name) {
+                old = &b;
+            }
+        }
+        if (old == NULL) {
+            cerr << res.name << ": not in baseline" << endl;
+            continue;
+        }
+        for (size_t p = 0; p < NUM_PHASES; p++) {
+            const Json *phase = old->get(PHASES[p]);
+            const Json *ns = phase ? phase->get("ns_per_edge") : NULL;
+            if (ns == NULL || ns->type != Json::NUMBER) {
+                continue;
+            }
+            double current = res.phases[p].mean() * 1e9 / res.edges(p);
+            cerr << res.name << " " << PHASES[p] << ": " << current
+                 << " ns per edge, baseline " << ns->number << endl;
+            if (current > ns->number * (1 + tolerance)) {
+                regressions.push_back(
+                    Regression { res.name, PHASES[p], ns->number, current });
+            }
+        }
+    }
+    return regressions;
+}
+
+double since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now()
+                                    - start).count();
+}
+
+int main(int argc, char **argv) {
+
+    Table config;
+    const char *value;
+    vector<string> graphs = { "er", "ba", "rmat" };
+    size_t vertices = DEFAULT_VERTICES;
+    size_t degree = DEFAULT_DEGREE;
+    unsigned long seed = DEFAULT_SEED;
+    size_t runs = DEFAULT_RUNS;
+    size_t warmup = DEFAULT_WARMUP;
+    string dir = "/tmp";
+    string output;
+    string baseline;
+    double tolerance = DEFAULT_TOLERANCE;
+
+    for (int i = 1; i < argc; i++) {
+        if ((value = long_arg(argv[i], GRAPHS_ARG))) {
+            graphs.clear();
+            stringstream list(value);
+            string g;
+            while (getline(list, g, ',')) {
+                if (g != "er" && g != "ba" && g != "rmat") {
+                    cerr << "Invalid graphs argument" << endl;
+                    exit(1);
+                }
+                graphs.push_back(g);
+            }
+        } else if ((value = long_arg(argv[i], VERTICES_ARG))) {
+            vertices = size_arg(value, "vertices");
+        } else if ((value = long_arg(argv[i], DEGREE_ARG))) {
+            degree = size_arg(value, "degree");
+        } else if ((value = long_arg(argv[i], SEED_ARG))) {
+            seed = size_arg(value, "seed");
+        } else if ((value = long_arg(argv[i], RUNS_ARG))) {
+            runs = size_arg(value, "runs");
+        } else if ((value = long_arg(argv[i], WARMUP_ARG))) {
+            warmup = size_arg(value, "warmup");
+        } else if (!strcmp(argv[i], THREADS_ARG) && i + 1 < argc) {
+            config.set_num_threads(size_arg(argv[++i], "threads"));
+        } else if ((value = long_arg(argv[i], SOLVER_ARG))) {
+            Solver solver;
+            if (!parse_solver(value, solver)) {
+                cerr << "Invalid solver argument" << endl;
+                exit(1);
+            }
+            config.set_solver(solver);
+        } else if ((value = long_arg(argv[i], EXTRAPOLATE_ARG))) {
+            Extrapolation extrapolation;
+            if (!parse_extrapolation(value, extrapolation)) {
+                cerr << "Invalid extrapolate argument" << endl;
+                exit(1);
+            }
+            config.set_extrapolation(extrapolation);
+        } else if (!strcmp(argv[i], FLOAT_ARG)) {
+            config.set_float_ranks(true);
+        } else if (!strcmp(argv[i], COMPRESS_ARG)) {
+            config.set_compress(true);
+        } else if (!strcmp(argv[i], LUMP_DANGLING_ARG)) {
+            config.set_lump_dangling(true);
+        } else if ((value = long_arg(argv[i], KERNEL_ARG))) {
+            IterationKernel kernel;
+            if (!parse_kernel(value, kernel)) {
+                cerr << "Invalid kernel argument" << endl;
+                exit(1);
+            }
+            config.set_iteration_kernel(kernel);
+        } else if (!strcmp(argv[i], NUMA_ARG)) {
+            config.set_numa(true);
+        } else if (!strcmp(argv[i], NUMA_REPLICATE_ARG)) {
+            config.set_numa_replicate(true);
+        } else if ((value = long_arg(argv[i], DIR_ARG))) {
+            dir = value;
+        } else if ((value = long_arg(argv[i], OUTPUT_ARG))) {
+            output = value;
+        } else if ((value = long_arg(argv[i], BASELINE_ARG))) {
+            baseline = value;
+        } else if ((value = long_arg(argv[i], TOLERANCE_ARG))) {
+            tolerance = strtod(value, NULL);
+        } else {
+            usage();
+            exit(1);
+        }
+    }
+    if (vertices < 2 || degree == 0 || runs == 0) {
+        usage();
+        exit(1);
+    }
+
+    vector<Result> results;
+    for (const string &graph : graphs) {
+        Result res;
+        res.graph = graph;
+        res.seed = seed;
+        res.vertices = vertices;
+        if (graph == "rmat") {
+            res.vertices = 1;
+            while (res.vertices < vertices) {
+                res.vertices <<= 1;
+            }
+        }
+        ostringstream name;
+        name << graph << "-n" << res.vertices << "-d" << degree << "-s"
+             << seed;
+        res.name = name.str();
+
+        string filename = dir + "/pagerank-bench-" + res.name + ".txt";
+        cerr << "Generating " << res.name << "..." << endl;
+        {
+            mt19937_64 rng(seed);
+            ArcWriter out(filename);
+            if (graph == "er") {
+                generate_er(out, res.vertices, degree, rng);
+            } else if (graph == "ba") {
+                generate_ba(out, res.vertices, degree, rng);
+            } else {
+                generate_rmat(out, res.vertices, degree, rng);
+            }
+            res.lines = out.size();
+        }
+
+        for (size_t r = 0; r < warmup + runs; r++) {
+            Table t;
+            t.set_numeric(true);
+            t.set_delim(" ");
+            t.set_num_threads(config.get_num_threads());
+            t.set_solver(config.get_solver());
+            t.set_extrapolation(config.get_extrapolation());
+            t.set_float_ranks(config.get_float_ranks());
+            t.set_compress(config.get_compress());
+            t.set_lump_dangling(config.get_lump_dangling());
+            t.set_iteration_kernel(config.get_iteration_kernel());
+            t.set_numa(config.get_numa());
+            t.set_numa_replicate(config.get_numa_replicate());
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            t.read_file(filename, false);
+            double load = since(start);
+            start = chrono::steady_clock::now();
+            t.build_graph();
+            double build = since(start);
+            start = chrono::steady_clock::now();
+            t.pagerank();
+            double iterate = since(start);
+
+            res.arcs = t.get_num_arcs();
+            res.iterations = t.get_num_iterations();
+            if (r >= warmup) {
+                res.phases[0].seconds.push_back(load);
+                res.phases[1].seconds.push_back(build);
+                res.phases[2].seconds.push_back(iterate);
+            }
+        }
+        remove(filename.c_str());
+        results.push_back(res);
+    }
+
+    vector<Regression> regressions;
+    if (!baseline.empty()) {
+        regressions = compare(baseline, results, tolerance);
+        for (const Regression &g : regressions) {
+            cerr << "REGRESSION " << g.name << " " << g.phase << ": "
+                 << g.current << " ns per edge, baseline " << g.baseline
+                 << endl;
+        }
+    }
+
+    if (output.empty()) {
+        write_json(cout, config, runs, warmup, results,
+                   baseline.empty() ? NULL : &regressions);
+    } else {
+        ofstream out(output.c_str());
+        if (!out.is_open()) {
+            cerr << "Cannot open file " << output << endl;
+            exit(1);
+        }
+        write_json(out, config, runs, warmup, results,
+                   baseline.empty() ? NULL : &regressions);
+    }
+    return regressions.empty() ? 0 : 2;
+}
@@ -36,18 +36,23 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
 
 #include <errno.h>
 #include <dirent.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 // Paul Kelly: for exercise
 //#include <time.h>
 #include <sys/time.h> 
 
 #include "table.h"
+#include "group_varint.h"
+#include "transport.h"
 
 using namespace std;
 
@@ -64,9 +69,583 @@ void error(const string p,const string p2) {
 }
 
 void usage() {
-    cerr << "Usage: pagerank_test [-jp] <test_suite>" << endl
+    cerr << "Usage: pagerank_test [-jpcx] [-T threads] <test_suite>" << endl
          << " -j use Java test results" << endl
-         << " -p use Python test results (default)" << endl;
+         << " -p use Python test results (default)" << endl
+         << " -T number of threads for the pagerank calculation" << endl
+         << " -c count hardware events while loading each graph and in "
+         << "each iteration" << endl
+         << " -x also check group varint coding, and the other "
+         << "calculations of each" << endl
+         << "    graph against its plain calculation" << endl;
+}
+
+/*
+ * Prints what is checked, before any details of a failure.
+ */
+void checking(const string &what) {
+    cout << "checking " << what << "...";
+}
+
+/*
+ * Prints the outcome of a check.
+ */
+void report(bool ok) {
+    cout << (ok ? " OK" : " Failed") << endl;
+}
+
+/*
+ * Returns true if result has the same ranks as expected, to EPSILON.
+ */
+bool same_pagerank(const vector<double> &expected,
+                   const vector<double> &result) {
+    if (result.size() != expected.size()) {
+        cout << " " << result.size() << " ranks instead of "
+             << expected.size();
+        return false;
+    }
+    for (size_t i = 0; i < result.size(); i++) {
+        double diff = abs(result[i] - expected[i]);
+        if (!(diff <= EPSILON)) {
+            cout << " error for vertex " << i << ": result=" << result[i]
+                 << " expected=" << expected[i] << " diff=" << diff;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Codes runs of values of every length, with every byte length and the
+ * values at the boundaries between them, and checks that they decode to
+ * the same values and take the bytes group_varint_size() gives.
+ */
+bool check_group_varint() {
+    const uint32_t edges[] = { 0, 1, 255, 256, 65535, 65536, 16777215,
+                               16777216, 4294967295u };
+    srand(1);
+    for (size_t n = 0; n <= 1000; n += (n < 16) ? 1 : 97) {
+        vector<uint32_t> values(n);
+        for (size_t k = 0; k < n; k++) {
+            if (k % 3 == 0) {
+                values[k] = edges[(k / 3) % (sizeof(edges) / sizeof(*edges))];
+            } else {
+                values[k] = (uint32_t) rand() >> (rand() % 32);
+            }
+        }
+        size_t bytes = group_varint_size(values.data(), n);
+        vector<uint8_t> coded(bytes + GROUP_VARINT_PADDING);
+        uint8_t *end = put_group_varint(coded.data(), values.data(), n);
+        vector<uint32_t> decoded((n + 3) / 4 * 4);
+        const uint8_t *read = get_group_varint(coded.data(), decoded.data(),
+                                               n);
+        decoded.resize(n);
+        if (end != coded.data() + bytes || read != end || decoded != values) {
+            cout << " " << n << " values do not round trip";
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Removes dir and the files in it.
+ */
+void remove_dir(const string &dir) {
+    DIR *d = opendir(dir.c_str());
+    if (d != NULL) {
+        struct dirent *entry;
+        while ((entry = readdir(d)) != NULL) {
+            string name = entry->d_name;
+            if (name != "." && name != "..") {
+                unlink((dir + "/" + name).c_str());
+            }
+        }
+        closedir(d);
+    }
+    rmdir(dir.c_str());
+}
+
+/*
+ * Reads the graph in filename into t, as the suite's graphs are read.
+ */
+void read_graph(Table &t, const string &filename) {
+    t.set_numeric(true);
+    t.set_delim(" ");
+    t.read_file(filename);
+}
+
+/*
+ * The iterations on several threads should give the ranks of a single
+ * thread, whatever the driver's -T.
+ */
+void check_threads(const string &graph_filename) {
+    Table single;
+    single.set_num_threads(1);
+    read_graph(single, graph_filename);
+    single.pagerank();
+    Table multi;
+    multi.set_num_threads(4);
+    read_graph(multi, graph_filename);
+    multi.pagerank();
+    checking("4 threads against 1");
+    report(same_pagerank(single.get_pagerank(), multi.get_pagerank()));
+}
+
+/*
+ * Gauss-Seidel on one and several threads, and SOR, should converge to
+ * the ranks of the power method.
+ */
+void check_solvers(const string &graph_filename,
+                   const vector<double> &expected) {
+    const size_t threads[] = { 1, 3 };
+    for (size_t n : threads) {
+        Table t;
+        t.set_solver(SOLVER_GAUSS_SEIDEL);
+        t.set_num_threads(n);
+        read_graph(t, graph_filename);
+        t.pagerank();
+        checking("Gauss-Seidel with -T " + to_string(n));
+        report(same_pagerank(expected, t.get_pagerank()));
+    }
+    Table t;
+    t.set_solver(SOLVER_SOR);
+    t.set_omega(1.2);
+    read_graph(t, graph_filename);
+    t.pagerank();
+    checking("SOR with omega 1.2");
+    report(same_pagerank(expected, t.get_pagerank()));
+}
+
+/*
+ * The push kernel, on one thread and several, should give the ranks of
+ * the pull iterations.
+ */
+void check_push(const string &graph_filename,
+                const vector<double> &expected) {
+    const size_t threads[] = { 1, 4 };
+    for (size_t n : threads) {
+        Table t;
+        t.set_iteration_kernel(KERNEL_PUSH);
+        t.set_num_threads(n);
+        read_graph(t, graph_filename);
+        t.pagerank();
+        checking("push kernel with -T " + to_string(n));
+        report(same_pagerank(expected, t.get_pagerank()));
+    }
+}
+
+/*
+ * Quadratic extrapolation, every fourth iteration so that even the
+ * smallest graphs are extrapolated, should converge to the same ranks.
+ */
+void check_extrapolation(const string &graph_filename,
+                         const vector<double> &expected) {
+    Table t;
+    t.set_extrapolation(EXTRAPOLATE_QUADRATIC);
+    t.set_extrapolation_period(4);
+    read_graph(t, graph_filename);
+    t.pagerank();
+    checking("quadratic extrapolation");
+    report(same_pagerank(expected, t.get_pagerank()));
+}
+
+/*
+ * SOR with omega 1.9 diverges on a ring of vertices that each link to
+ * the next three, and pagerank() should then exit with an error rather
+ * than go on or report the ranks. It runs in a child process, as
+ * error() exits.
+ */
+void check_divergence() {
+    char scratch[] = "/tmp/pagerank_test-XXXXXX";
+    if (mkdtemp(scratch) == NULL) {
+        error("Cannot create directory", scratch);
+    }
+    string ring = string(scratch) + "/ring.txt";
+    {
+        ofstream out(ring.c_str());
+        const size_t n = 1000;
+        for (size_t i = 0; i < n; i++) {
+            for (size_t d = 1; d <= 3; d++) {
+                out << i << " " << (i + d) % n << endl;
+            }
+        }
+    }
+    checking("SOR divergence");
+    cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (freopen("/dev/null", "w", stderr) == NULL) {
+            _exit(2);
+        }
+        Table t;
+        t.set_solver(SOLVER_SOR);
+        t.set_omega(1.9);
+        read_graph(t, ring);
+        t.pagerank();
+        _exit(0);
+    }
+    int status = 0;
+    bool ok = pid > 0 && waitpid(pid, &status, 0) == pid
+        && WIFEXITED(status) && WEXITSTATUS(status) == 1;
+    report(ok);
+    unlink(ring.c_str());
+    rmdir(scratch);
+}
+
+/*
+ * Returns the pageranks of teleport vector s of the last call to
+ * personalized_pagerank() on t.
+ */
+vector<double> personalized_lane(Table &t, size_t s) {
+    const vector<double> &ppr = t.get_personalized_pagerank();
+    size_t n = t.get_num_personalized();
+    vector<double> lane(ppr.size() / n);
+    for (size_t i = 0; i < lane.size(); i++) {
+        lane[i] = ppr[i * n + s];
+    }
+    return lane;
+}
+
+/*
+ * A teleport vector spread evenly over all vertices should give the
+ * global ranks, and a seed's ranks should not depend on the vectors
+ * calculated in the same batch.
+ */
+void check_personalized(const string &graph_filename,
+                        const vector<double> &expected) {
+    Table t;
+    read_graph(t, graph_filename);
+    size_t n = t.get_num_rows();
+    vector<vector<pair<size_t, double> > > teleport(3);
+    for (size_t i = 0; i < n; i++) {
+        teleport[0].push_back(make_pair(i, 1.0));
+    }
+    teleport[1].push_back(make_pair(0, 1.0));
+    teleport[2].push_back(make_pair(n / 2, 1.0));
+    teleport[2].push_back(make_pair(n - 1, 1.0));
+    t.personalized_pagerank(teleport);
+    checking("personalized pagerank of all vertices");
+    report(same_pagerank(expected, personalized_lane(t, 0)));
+    vector<double> batched = personalized_lane(t, 2);
+    teleport.erase(teleport.begin(), teleport.begin() + 2);
+    t.personalized_pagerank(teleport);
+    checking("personalized pagerank in a batch against alone");
+    report(same_pagerank(personalized_lane(t, 0), batched));
+}
+
+/*
+ * Pushing residual out from a single seed, the source of the first arc,
+ * should approximate the personalized pagerank of the seed to within
+ * EPSILON.
+ */
+void check_local_push(const string &graph_filename) {
+    Table t;
+    read_graph(t, graph_filename);
+    ifstream in(graph_filename.c_str());
+    string source;
+    in >> source;
+    size_t seed = t.find_vertex(source);
+    vector<vector<pair<size_t, double> > > teleport(1);
+    teleport[0].push_back(make_pair(seed, 1.0));
+    t.personalized_pagerank(teleport);
+    vector<pair<size_t, double> > top;
+    t.local_pagerank(seed, 1e-8, 0, top);
+    vector<double> local(t.get_num_rows());
+    for (size_t k = 0; k < top.size(); k++) {
+        local[top[k].first] = top[k].second;
+    }
+    checking("local push");
+    report(same_pagerank(personalized_lane(t, 0), local));
+}
+
+/*
+ * Returns the ranks of t in the numbering of plain, which holds the same
+ * graph, matching the vertices by name.
+ */
+vector<double> by_name(Table &plain, Table &t) {
+    const vector<double> &ranks = t.get_pagerank();
+    vector<double> result(ranks.size());
+    for (size_t i = 0; i < ranks.size(); i++) {
+        size_t j = plain.find_vertex(t.get_node_name(i));
+        if (j >= result.size()) {
+            error("No vertex in the input numbering named",
+                  t.get_node_name(i));
+        }
+        result[j] = ranks[i];
+    }
+    return result;
+}
+
+/*
+ * Every vertex order should give each vertex the rank it has in the
+ * input's numbering.
+ */
+void check_reorders(const string &graph_filename,
+                    const vector<double> &expected) {
+    const Reorder orders[] = { REORDER_DEGREE, REORDER_RCM, REORDER_GORDER,
+                               REORDER_DANGLING };
+    Table plain;
+    read_graph(plain, graph_filename);
+    for (Reorder r : orders) {
+        Table t;
+        read_graph(t, graph_filename);
+        t.reorder_vertices(r);
+        t.pagerank();
+        checking(string("vertices reordered by ") + reorder_name(r));
+        report(same_pagerank(expected, by_name(plain, t)));
+    }
+}
+
+void check_compressed(const string &graph_filename,
+                      const vector<double> &expected) {
+    Table t;
+    t.set_compress(true);
+    read_graph(t, graph_filename);
+    t.pagerank();
+    checking("compressed in-links");
+    report(same_pagerank(expected, t.get_pagerank()));
+}
+
+/*
+ * Every 50th arc is held back and added as a change, and every 97th of
+ * the others removed; update_pagerank() should then give the ranks that
+ * pagerank() gives on the changed graph.
+ */
+void check_update(const string &graph_filename, const string &dir) {
+    ifstream in(graph_filename.c_str());
+    ofstream base((dir + "/base.txt").c_str());
+    ofstream changes((dir + "/changes.txt").c_str());
+    string line;
+    for (size_t k = 0; getline(in, line); k++) {
+        if (line.empty()) {
+            continue;
+        }
+        if (k % 50 == 0) {
+            changes << "+ " << line << endl;
+        } else {
+            base << line << endl;
+            if (k % 97 == 0) {
+                changes << "- " << line << endl;
+            }
+        }
+    }
+    base.close();
+    changes.close();
+    Table t;
+    read_graph(t, dir + "/base.txt");
+    t.pagerank();
+    t.read_changes(dir + "/changes.txt");
+    t.update_pagerank();
+    vector<double> updated = t.get_pagerank();
+    t.pagerank();
+    checking("incremental update");
+    report(same_pagerank(t.get_pagerank(), updated));
+    unlink((dir + "/base.txt").c_str());
+    unlink((dir + "/changes.txt").c_str());
+}
+
+void check_snapshot(const string &graph_filename,
+                    const vector<double> &expected, const string &dir) {
+    Table t;
+    read_graph(t, graph_filename);
+    t.save_binary(dir + "/graph.prg");
+    Table loaded;
+    loaded.load_binary(dir + "/graph.prg", true);
+    loaded.pagerank();
+    checking("snapshot");
+    report(same_pagerank(expected, loaded.get_pagerank()));
+    unlink((dir + "/graph.prg").c_str());
+}
+
+/*
+ * The graph sharded out of core, in shards of a single block, should
+ * give the same ranks, both as sharded and as loaded back from the
+ * shards.
+ */
+void check_shards(const string &graph_filename,
+                  const vector<double> &expected, const string &dir) {
+    string shards = dir + "/shards";
+    Table t;
+    t.set_numeric(true);
+    t.set_delim(" ");
+    t.shard_file(graph_filename, shards, REDUCE_BLOCK);
+    t.pagerank();
+    checking("shards");
+    report(same_pagerank(expected, t.get_pagerank()));
+    Table loaded;
+    loaded.load_shards(shards);
+    loaded.pagerank();
+    checking("loaded shards");
+    report(same_pagerank(expected, loaded.get_pagerank()));
+    remove_dir(shards);
+}
+
+/*
+ * Workers sharing the shards over each transport should give the same
+ * ranks. Worker 0 hands them back through a file, as the workers may
+ * run in other processes.
+ */
+void check_workers(const string &graph_filename,
+                   const vector<double> &expected, const string &dir) {
+    string shards = dir + "/shards";
+    {
+        Table t;
+        t.set_numeric(true);
+        t.set_delim(" ");
+        t.shard_file(graph_filename, shards, REDUCE_BLOCK);
+    }
+    const TransportKind kinds[] = { TRANSPORT_SHM, TRANSPORT_UNIX,
+                                    TRANSPORT_TCP };
+    string ranks = dir + "/ranks";
+    for (TransportKind kind : kinds) {
+        Table t;
+        t.load_shards(shards);
+        bool ran = run_workers(3, kind, [&](Transport &transport) {
+            t.distributed_pagerank(transport);
+            if (transport.rank() == 0) {
+                const vector<double> &pr = t.get_pagerank();
+                ofstream out(ranks.c_str(), ios::binary);
+                out.write((const char *) pr.data(),
+                          pr.size() * sizeof(double));
+            }
+        });
+        vector<double> result;
+        ifstream in(ranks.c_str(), ios::binary);
+        double value;
+        while (in.read((char *) &value, sizeof(value))) {
+            result.push_back(value);
+        }
+        checking(string("workers over ") + transport_name(kind));
+        report(ran && same_pagerank(expected, result));
+        unlink(ranks.c_str());
+    }
+    remove_dir(shards);
+}
+
+/*
+ * Reads back the ranks of a file written by save_pagerank_binary(),
+ * whose header is laid out as README.md describes, checking that they
+ * are value_size bytes each.
+ */
+vector<double> read_ranks(const string &filename, uint32_t value_size) {
+    struct {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t value_size;
+        uint32_t flags;
+        uint64_t num_rows;
+        uint64_t num_names;
+        uint64_t names_bytes;
+    } header;
+    vector<double> ranks;
+    ifstream in(filename.c_str(), ios::binary);
+    if (!in.read((char *) &header, sizeof(header))
+        || strcmp(header.magic, "PRRANKS") != 0
+        || header.value_size != value_size) {
+        cout << " bad header in " << filename;
+        return ranks;
+    }
+    for (uint64_t i = 0; i < header.num_rows && in; i++) {
+        if (value_size == sizeof(float)) {
+            float f;
+            if (in.read((char *) &f, sizeof(f))) {
+                ranks.push_back(f);
+            }
+        } else {
+            double d;
+            if (in.read((char *) &d, sizeof(d))) {
+                ranks.push_back(d);
+            }
+        }
+    }
+    return ranks;
+}
+
+/*
+ * Lumping the dangling vertices, which renumbers them last, should give
+ * each vertex, matched by name, the rank of the plain calculation.
+ */
+void check_lumped(const string &graph_filename,
+                  const vector<double> &expected) {
+    Table plain;
+    read_graph(plain, graph_filename);
+    Table t;
+    t.set_lump_dangling(true);
+    read_graph(t, graph_filename);
+    t.pagerank();
+    checking("lumped dangling vertices");
+    report(same_pagerank(expected, by_name(plain, t)));
+}
+
+/*
+ * The binary output, in doubles and in floats, should read back as the
+ * ranks, and the top vertices selected on several threads should be
+ * those of a full sort, ties going to the lower vertex number.
+ */
+void check_output(const string &graph_filename, const string &dir) {
+    Table t;
+    t.set_num_threads(4);
+    read_graph(t, graph_filename);
+    t.pagerank();
+    const vector<double> &pr = t.get_pagerank();
+    string ranks = dir + "/ranks.bin";
+    t.save_pagerank_binary(ranks);
+    checking("binary output");
+    report(same_pagerank(pr, read_ranks(ranks, sizeof(double))));
+    t.save_pagerank_binary(ranks, true);
+    checking("binary output in floats");
+    report(same_pagerank(pr, read_ranks(ranks, sizeof(float))));
+    unlink(ranks.c_str());
+
+    vector<pair<size_t, double> > sorted;
+    for (size_t i = 0; i < pr.size(); i++) {
+        sorted.push_back(make_pair(i, pr[i]));
+    }
+    sort(sorted.begin(), sorted.end(),
+         [](const pair<size_t, double> &a, const pair<size_t, double> &b) {
+             return a.second > b.second
+                 || (a.second == b.second && a.first < b.first);
+         });
+    const size_t ks[] = { 1, 10, pr.size() };
+    for (size_t k : ks) {
+        vector<pair<size_t, double> > top;
+        t.top_pagerank(k, top);
+        vector<pair<size_t, double> > expected(sorted.begin(),
+                                               sorted.begin() + k);
+        checking("top vertices with k = " + to_string(k));
+        report(top == expected);
+    }
+}
+
+/*
+ * Checks the other calculations of the graph in graph_filename against
+ * its plain one, expected, with the files they need in a scratch
+ * directory under /tmp.
+ */
+void check_variants(const string &graph_filename,
+                    const vector<double> &expected) {
+    char scratch[] = "/tmp/pagerank_test-XXXXXX";
+    if (mkdtemp(scratch) == NULL) {
+        error("Cannot create directory", scratch);
+    }
+    string dir = scratch;
+    check_threads(graph_filename);
+    check_solvers(graph_filename, expected);
+    check_extrapolation(graph_filename, expected);
+    check_push(graph_filename, expected);
+    check_update(graph_filename, dir);
+    check_personalized(graph_filename, expected);
+    check_local_push(graph_filename);
+    check_reorders(graph_filename, expected);
+    check_lumped(graph_filename, expected);
+    check_output(graph_filename, dir);
+    check_compressed(graph_filename, expected);
+    check_snapshot(graph_filename, expected, dir);
+    check_shards(graph_filename, expected, dir);
+    check_workers(graph_filename, expected, dir);
+    remove_dir(dir);
 }
 
 int main(int argc, char *argv[]) {
@@ -74,23 +653,38 @@ int main(int argc, char *argv[]) {
     Table t;
     bool java_test = false;
     bool python_test = true;
+    bool counters = false;
+    bool variants = false;
 
-    if (argc == 3) {
-        if (!strcmp(argv[1], "-j")) {
+    if (argc < 2) {
+        usage();
+        exit(1);
+    }
+    for (int i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "-j")) {
             java_test = true;
             python_test = false;
-        } else if (!strcmp(argv[1], "-p")) {
+        } else if (!strcmp(argv[i], "-p")) {
             java_test = false;
             python_test = true;
+        } else if (!strcmp(argv[i], "-c")) {
+            counters = true;
+        } else if (!strcmp(argv[i], "-x")) {
+            variants = true;
+        } else if (!strcmp(argv[i], "-T") && i + 1 < argc - 1) {
+            t.set_num_threads(strtol(argv[++i], NULL, 10));
         } else {
             usage();
             exit(1);
         } 
-    } else if (argc < 2) {
-        usage();
-        exit(1);
     }
     
+    if (counters && t.enable_perf_counters() == 0) {
+        cerr << "Hardware counters are unavailable, continuing without them"
+             << endl;
+        counters = false;
+    }
+
     string tests_filename = argv[argc - 1];
 
     ifstream tests_file(tests_filename.c_str());
@@ -100,6 +694,12 @@ int main(int argc, char *argv[]) {
     }
 
     //cout.precision(numeric_limits<double>::digits10);
+
+    if (variants) {
+        checking("group varint coding");
+        report(check_group_varint());
+        check_divergence();
+    }
     
     while (!tests_file.eof()) {
         string test_line;
@@ -139,6 +739,9 @@ int main(int argc, char *argv[]) {
 	micros_used= ((secs_used*1000000) + end.tv_usec) - (start.tv_usec);
 
 	cout << "Pagerank time(s): " << ((float)micros_used)/1000000.0f << endl;
+        if (counters) {
+            t.get_stats().write_counters(cout);
+        }
 
         /* Read pagerank test results file */
         vector<double> pagerank_test_values;
@@ -188,6 +791,9 @@ int main(int argc, char *argv[]) {
         } else {
             cout << " Failed" << endl;
         }
+        if (variants) {
+            check_variants(graph_filename, pagerank_results);
+        }
     }
     
 }
@@ -0,0 +1,251 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "table.h"
+
+/*
+ * A vertex name inside the mapped input file.
+ */
+struct NameRef {
+    const char *name;
+    size_t len;
+    uint64_t hash;
+};
+
+static inline bool is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/*
+ * Trims leading and trailing \t and " " characters from [begin, end),
+ * like Table::trim does for strings.
+ */
+static inline void trim_range(const char *&begin, const char *&end) {
+    while (begin < end && is_blank(*begin)) {
+        begin++;
+    }
+    while (end > begin && is_blank(end[-1])) {
+        end--;
+    }
+}
+
+/*
+ * Parses a base 10 integer at the start of [p, end), the way strtol
+ * does: leading white space and a sign are accepted, and parsing stops
+ * at the first character that is not a digit.
+ */
+static inline size_t parse_index(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || (*p >= '\t' && *p <= '\r'))) {
+        p++;
+    }
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    size_t value = 0;
+    while (p < end && (unsigned char) (*p - '0') < 10) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    return negative ? -value : value;
+}
+
+/*
+ * Returns the first occurrence of delim in [begin, end), or NULL.
+ */
+static inline const char *find_delim(const char *begin, const char *end,
+                                     const char *delim, size_t delim_len) {
+    if (delim_len == 0) {
+        return begin;
+    }
+    if ((size_t) (end - begin) < delim_len) {
+        return NULL;
+    }
+    const char *last = end - delim_len;
+    const char *p = begin;
+    while (p <= last) {
+        p = (const char *) memchr(p, delim[0], last - p + 1);
+        if (p == NULL) {
+            return NULL;
+        }
+        if (memcmp(p + 1, delim + 1, delim_len - 1) == 0) {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+/*
+ * Returns the start of the first line at or after pos.
+ */
+static size_t line_start(const char *data, size_t size, size_t pos) {
+    if (pos == 0 || pos >= size || data[pos - 1] == '\n') {
+        return min(pos, size);
+    }
+    const char *eol = (const char *) memchr(data + pos, '\n', size - pos);
+    return eol ? (eol - data) + 1 : size;
+}
+
+bool Table::read_mapped(const string &filename) {
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    const char *data = (const char *) map;
+    RunStats::Mark start = stats.mark();
+
+    size_t num_chunks = num_threads;
+    vector<size_t> chunk_bounds(num_chunks + 1);
+    for (size_t c = 1; c < num_chunks; c++) {
+        chunk_bounds[c] = max(chunk_bounds[c - 1],
+                              line_start(data, size, size / num_chunks * c));
+    }
+    chunk_bounds[num_chunks] = size;
+
+    const char *delim_str = delim.c_str();
+    size_t delim_len = delim.length();
+    vector<size_t> chunk_lines(num_chunks);
+    vector<size_t> chunk_max(num_chunks);
+    vector< vector<NameRef> > chunk_names(numeric ? 0 : num_chunks);
+    pending_arcs.assign(num_chunks, ArcBuffer());
+
+#pragma omp parallel for schedule(static, 1) num_threads(num_chunks)
+    for (size_t c = 0; c < num_chunks; c++) {
+        const char *p = data + chunk_bounds[c];
+        const char *chunk_end = data + chunk_bounds[c + 1];
+        ArcBuffer &arcs = pending_arcs[c];
+        size_t lines = 0;
+        size_t max_idx = 0;
+        bool any = false;
+        while (p < chunk_end) {
+            const char *eol = (const char *) memchr(p, '\n', chunk_end - p);
+            const char *line_end = eol ? eol : chunk_end;
+            const char *pos = find_delim(p, line_end, delim_str, delim_len);
+            if (pos != NULL) {
+                const char *from = p;
+                const char *from_end = pos;
+                const char *to = pos + delim_len;
+                const char *to_end = line_end;
+                trim_range(from, from_end);
+                trim_range(to, to_end);
+                if (numeric) {
+                    size_t from_idx = parse_index(from, from_end);
+                    size_t to_idx = parse_index(to, to_end);
+                    arcs.from.push_back(from_idx);
+                    arcs.to.push_back(to_idx);
+                    max_idx = max(max_idx, max(from_idx, to_idx));
+                    any = true;
+                } else {
+                    size_t from_len = from_end - from;
+                    size_t to_len = to_end - to;
+                    NameRef from_ref = { from, from_len,
+                                         StringPool::hash(from, from_len) };
+                    NameRef to_ref = { to, to_len,
+                                       StringPool::hash(to, to_len) };
+                    chunk_names[c].push_back(from_ref);
+                    chunk_names[c].push_back(to_ref);
+                }
+            }
+            lines++;
+            p = line_end + 1;
+        }
+        chunk_lines[c] = lines;
+        chunk_max[c] = any ? max_idx + 1 : 0;
+    }
+
+    size_t linenum = 0;
+    for (size_t c = 0; c < num_chunks; c++) {
+        linenum += chunk_lines[c];
+        num_rows = max(num_rows, chunk_max[c]);
+    }
+
+    stats.add_phase("parse", start);
+
+    /*
+     * String IDs are numbered in order of first appearance, so they are
+     * mapped by a single pass over the chunks in file order; only the
+     * hashing has been done in parallel.
+     */
+    if (!numeric) {
+        start = stats.mark();
+        for (size_t c = 0; c < num_chunks; c++) {
+            vector<NameRef> &names = chunk_names[c];
+            ArcBuffer &arcs = pending_arcs[c];
+            arcs.from.reserve(names.size() / 2);
+            arcs.to.reserve(names.size() / 2);
+            for (size_t k = 0; k < names.size(); k += 2) {
+                const NameRef &from = names[k];
+                const NameRef &to = names[k + 1];
+                arcs.from.push_back(node_names.intern(from.name, from.len,
+                                                      from.hash));
+                arcs.to.push_back(node_names.intern(to.name, to.len,
+                                                    to.hash));
+            }
+            vector<NameRef>().swap(names);
+        }
+        num_rows = max(num_rows, node_names.size());
+        stats.add_phase("intern", start);
+    }
+
+    munmap(map, size);
+
+    report_progress(linenum);
+
+    return true;
+}
@@ -0,0 +1,160 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+
+#include "perf_counters.h"
+
+using namespace std;
+
+static const char *EVENT_NAMES[NUM_PERF_EVENTS] = {
+    "cycles",
+    "instructions",
+    "LLC-load-misses",
+    "dTLB-load-misses",
+    "branch-misses"
+};
+
+const char *perf_event_name(int e) {
+    return EVENT_NAMES[e];
+}
+
+PerfCounts::PerfCounts() {
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        values[e] = 0;
+        valid[e] = false;
+    }
+}
+
+PerfCounts PerfCounts::since(const PerfCounts &earlier) const {
+    PerfCounts d;
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        d.valid[e] = valid[e] && earlier.valid[e];
+        d.values[e] = d.valid[e] ? values[e] - earlier.values[e] : 0;
+    }
+    return d;
+}
+
+/*
+ * Fills in the type and config of the perf_event_attr for event e.
+ */
+static void event_config(int e, perf_event_attr &attr) {
+    const uint64_t cache_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    switch (e) {
+    case PERF_CYCLES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PERF_INSTRUCTIONS:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PERF_LLC_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_LL | cache_miss;
+        break;
+    case PERF_DTLB_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | cache_miss;
+        break;
+    default:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    }
+}
+
+PerfCounters::PerfCounters() : open_errno(0) {
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        event_config(e, attr);
+        /*
+         * Events are not grouped, as grouped events cannot be inherited
+         * by new threads and read together.
+         */
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+            | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fds[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                         PERF_FLAG_FD_CLOEXEC);
+        if (fds[e] < 0) {
+            fds[e] = -1;
+            if (open_errno == 0) {
+                open_errno = errno;
+            }
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        if (fds[e] >= 0) {
+            close(fds[e]);
+        }
+    }
+}
+
+size_t PerfCounters::num_available() const {
+    size_t n = 0;
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        n += fds[e] >= 0;
+    }
+    return n;
+}
+
+PerfCounts PerfCounters::read() const {
+    PerfCounts c;
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        uint64_t buf[3]; // value, time enabled, time running
+        c.valid[e] = fds[e] >= 0
+            && ::read(fds[e], buf, sizeof(buf)) == sizeof(buf);
+        c.values[e] = 0;
+        if (c.valid[e] && buf[2] > 0) {
+            c.values[e] = buf[2] < buf[1]
+                ? (uint64_t) ((double) buf[0] * buf[1] / buf[2]) : buf[0];
+        }
+    }
+    return c;
+}
@@ -0,0 +1,116 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstddef>
+#include <stdint.h>
+
+/*
+ * The hardware events counted by PerfCounters.
+ */
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_BRANCH_MISSES,
+    NUM_PERF_EVENTS
+};
+
+/*
+ * Returns the name under which perf(1) reports event e.
+ */
+const char *perf_event_name(int e);
+
+/*
+ * Counts of the hardware events over an interval. An event that could
+ * not be counted has valid[e] false.
+ */
+struct PerfCounts {
+    uint64_t values[NUM_PERF_EVENTS];
+    bool valid[NUM_PERF_EVENTS];
+
+    /*
+     * Creates counts in which no event was counted.
+     */
+    PerfCounts();
+
+    /*
+     * Returns the counts from earlier to these.
+     */
+    PerfCounts since(const PerfCounts &earlier) const;
+};
+
+/*
+ * Hardware performance counters of the process, read through
+ * perf_event_open(2). They count in user space only, on the thread
+ * that opens them and on every thread it starts afterwards, such as
+ * the OpenMP workers, so they should be opened before the first
+ * parallel region. Events that the kernel or the machine does not
+ * support, or that the perf_event_paranoid setting does not permit,
+ * are left out rather than failing; when the kernel multiplexes the
+ * events, the counts are scaled to the time they were enabled.
+ */
+class PerfCounters {
+private:
+    int fds[NUM_PERF_EVENTS]; // -1 for events that are not counted
+    int open_errno; // why the first event that could not be opened failed
+
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    /*
+     * Returns the number of events that are counted.
+     */
+    size_t num_available() const;
+
+    /*
+     * Returns the errno of the first event that could not be opened,
+     * or 0 if all of them were.
+     */
+    int get_errno() const { return open_errno; }
+
+    /*
+     * Returns the counts since the counters were opened.
+     */
+    PerfCounts read() const;
+};
+
+#endif
@@ -0,0 +1,363 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include <string>
+#include <limits>
+
+#include "table.h"
+#include "openmp.h"
+
+/*
+ * The seeds of the active lanes, by row: row i has the (lane, weight)
+ * pairs seeds[offsets[i]..[i + 1]), with weights normalised per lane.
+ */
+struct SeedIndex {
+    vector<size_t> offsets;
+    vector<pair<size_t, double> > seeds;
+
+    void build(size_t num_rows,
+               const vector<vector<pair<size_t, double> > > &teleport,
+               const vector<size_t> &lanes) {
+        offsets.assign(num_rows + 1, 0);
+        for (size_t l = 0; l < lanes.size(); l++) {
+            const vector<pair<size_t, double> > &v = teleport[lanes[l]];
+            for (size_t s = 0; s < v.size(); s++) {
+                offsets[v[s].first + 1]++;
+            }
+        }
+        for (size_t i = 0; i < num_rows; i++) {
+            offsets[i + 1] += offsets[i];
+        }
+        seeds.resize(offsets[num_rows]);
+        vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t l = 0; l < lanes.size(); l++) {
+            const vector<pair<size_t, double> > &v = teleport[lanes[l]];
+            for (size_t s = 0; s < v.size(); s++) {
+                seeds[next[v[s].first]++] = make_pair(l, v[s].second);
+            }
+        }
+    }
+};
+
+void Table::personalized_pagerank(
+    const vector<vector<pair<size_t, double> > > &teleport) {
+
+    size_t num_sets = teleport.size();
+    unsigned long num_iterations = 0;
+
+    num_personalized = num_sets;
+    ppr.assign(num_rows * num_sets, 0);
+    if (num_rows == 0 || num_sets == 0) {
+        return;
+    }
+
+    if (row_offsets.size() != num_rows + 1) {
+        build_graph();
+    }
+    unpack_links();
+    const size_t *links = in_links.data();
+    const size_t *offsets = row_offsets.data();
+    const size_t *outgoing = num_outgoing.data();
+
+    /* Normalise the teleport vectors, ignoring vertices not in the graph */
+    vector<vector<pair<size_t, double> > > v(num_sets);
+    for (size_t s = 0; s < num_sets; s++) {
+        double total = 0;
+        for (size_t e = 0; e < teleport[s].size(); e++) {
+            if (teleport[s][e].first < num_rows && teleport[s][e].second > 0) {
+                v[s].push_back(teleport[s][e]);
+                total += teleport[s][e].second;
+            }
+        }
+        if (v[s].empty()) {
+            error("Empty teleport vector for personalized pagerank");
+        }
+        for (size_t e = 0; e < v[s].size(); e++) {
+            v[s][e].second /= total;
+        }
+    }
+
+    vector<double> inv_outgoing(num_rows);
+    for (size_t k = 0; k < num_rows; k++) {
+        inv_outgoing[k] = outgoing[k] ? 1.0 / outgoing[k] : 0.0;
+    }
+
+    /*
+     * The pagerank vectors of the lanes still iterating are kept vertex
+     * major: the width values of vertex i are x[i * width..(i + 1) *
+     * width), so the in-links of a row are read once for all lanes.
+     * lanes[l] is the teleport vector of lane l.
+     */
+    size_t width = num_sets;
+    vector<size_t> lanes(num_sets);
+    vector<double> x(num_rows * width);
+    vector<double> contrib(num_rows * width);
+    vector<double> sum(width, 1);
+    vector<double> dangling(width, 0);
+    vector<double> diff(width, 0);
+    vector<double> coef(width); // weight of the teleport vector per lane
+    SeedIndex seeds;
+
+    /* Start from the teleport vectors themselves */
+    for (size_t l = 0; l < width; l++) {
+        lanes[l] = l;
+        for (size_t e = 0; e < v[l].size(); e++) {
+            size_t i = v[l][e].first;
+            x[i * width + l] += v[l][e].second;
+            if (outgoing[i] == 0) {
+                dangling[l] += v[l][e].second;
+            }
+        }
+    }
+    seeds.build(num_rows, v, lanes);
+
+    /*
+     * Dangling vertices jump back to the teleport vector of their lane,
+     * like all random jumps, so each lane's pagerank stays within the
+     * reach of its seeds.
+     */
+    for (size_t l = 0; l < width; l++) {
+        coef[l] = alpha * dangling[l] + (1 - alpha);
+    }
+
+    size_t nthreads = num_threads;
+    vector<size_t> bounds;
+    size_t num_blocks = (num_rows + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    vector<double> block_sum(num_blocks * width);
+    vector<double> block_dangling(num_blocks * width);
+    vector<double> block_diff(num_blocks * width);
+    vector<size_t> keep; // the lanes that go on after an iteration
+    vector<double> next_x;
+    bool drop = false;
+
+#pragma omp parallel num_threads(nthreads)
+    {
+#pragma omp single
+        partition_rows(omp_get_num_threads(), bounds, num_rows);
+
+        size_t t = omp_get_thread_num();
+        size_t first_row = min(bounds[t] * REDUCE_BLOCK, num_rows);
+        size_t last_row = min(bounds[t + 1] * REDUCE_BLOCK, num_rows);
+        vector<double> acc(num_sets);
+        vector<double> bsum(num_sets);
+        vector<double> bdangling(num_sets);
+        vector<double> bdiff(num_sets);
+
+        while (width > 0) {
+
+            size_t w = width;
+            for (size_t i = first_row; i < last_row; i++) {
+                double *xi = &x[i * w];
+                double *ci = &contrib[i * w];
+                for (size_t l = 0; l < w; l++) {
+                    xi[l] /= sum[l];
+                    ci[l] = xi[l] * inv_outgoing[i];
+                }
+            }
+
+#pragma omp barrier
+
+            for (size_t b = bounds[t]; b < bounds[t + 1]; b++) {
+                size_t first = b * REDUCE_BLOCK;
+                size_t last = min(first + REDUCE_BLOCK, num_rows);
+                fill(bsum.begin(), bsum.begin() + w, 0.0);
+                fill(bdangling.begin(), bdangling.begin() + w, 0.0);
+                fill(bdiff.begin(), bdiff.begin() + w, 0.0);
+                for (size_t i = first; i < last; i++) {
+                    double *a = acc.data();
+                    fill(a, a + w, 0.0);
+                    for (size_t k = offsets[i]; k < offsets[i + 1]; k++) {
+                        const double *cj = &contrib[links[k] * w];
+                        for (size_t l = 0; l < w; l++) {
+                            a[l] += cj[l];
+                        }
+                    }
+                    for (size_t l = 0; l < w; l++) {
+                        a[l] *= alpha;
+                    }
+                    for (size_t s = seeds.offsets[i]; s < seeds.offsets[i + 1];
+                         s++) {
+                        size_t l = seeds.seeds[s].first;
+                        a[l] += coef[l] * seeds.seeds[s].second;
+                    }
+                    double *xi = &x[i * w];
+                    for (size_t l = 0; l < w; l++) {
+                        bdiff[l] += fabs(a[l] - xi[l]);
+                        xi[l] = a[l];
+                        bsum[l] += a[l];
+                    }
+                    if (outgoing[i] == 0) {
+                        for (size_t l = 0; l < w; l++) {
+                            bdangling[l] += a[l];
+                        }
+                    }
+                }
+                for (size_t l = 0; l < w; l++) {
+                    block_sum[b * w + l] = bsum[l];
+                    block_dangling[b * w + l] = bdangling[l];
+                    block_diff[b * w + l] = bdiff[l];
+                }
+            }
+
+#pragma omp barrier
+#pragma omp single
+            {
+                num_iterations++;
+                keep.clear();
+                for (size_t l = 0; l < w; l++) {
+                    diff[l] = 0;
+                    sum[l] = 0;
+                    dangling[l] = 0;
+                    for (size_t b = 0; b < num_blocks; b++) {
+                        diff[l] += block_diff[b * w + l];
+                        sum[l] += block_sum[b * w + l];
+                        dangling[l] += block_dangling[b * w + l];
+                    }
+                    coef[l] = alpha * (dangling[l] / sum[l]) + (1 - alpha);
+                    if (diff[l] > convergence
+                        && num_iterations < max_iterations) {
+                        keep.push_back(l);
+                    }
+                }
+                drop = (keep.size() < w);
+                if (drop) {
+                    next_x.resize(num_rows * keep.size());
+                }
+                if (verbose) {
+                    cerr << "iteration " << num_iterations << " lanes = "
+                         << w << " converged = " << w - keep.size() << endl;
+                }
+            }
+
+            if (drop) {
+                /*
+                 * Converged lanes leave the batch: store their results and
+                 * compact the rest, so that later iterations only read
+                 * and write the lanes that are still active.
+                 */
+                size_t nw = keep.size();
+                for (size_t i = first_row; i < last_row; i++) {
+                    const double *xi = &x[i * w];
+                    for (size_t l = 0, n = 0; l < w; l++) {
+                        if (n < nw && keep[n] == l) {
+                            next_x[i * nw + n++] = xi[l];
+                        } else {
+                            ppr[i * num_sets + lanes[l]] = xi[l] / sum[l];
+                        }
+                    }
+                }
+
+#pragma omp barrier
+#pragma omp single
+                {
+                    x.swap(next_x);
+                    contrib.resize(num_rows * nw);
+                    for (size_t n = 0; n < nw; n++) {
+                        lanes[n] = lanes[keep[n]];
+                        sum[n] = sum[keep[n]];
+                        coef[n] = coef[keep[n]];
+                    }
+                    lanes.resize(nw);
+                    seeds.build(num_rows, v, lanes);
+                    width = nw;
+                }
+            }
+        }
+    }
+
+    cerr << "personalized pagerank of " << num_sets
+         << " teleport vectors finished after " << num_iterations
+         << " iterations" << endl;
+}
+
+int Table::read_seeds(const string &filename,
+                      vector<vector<pair<size_t, double> > > &teleport) {
+
+    ifstream infile(filename.c_str());
+    if (!infile) {
+        error("Cannot open file", filename.c_str());
+    }
+
+    string line;
+    while (getline(infile, line)) {
+        trim(line);
+        if (line.empty()) {
+            continue;
+        }
+        vector<pair<size_t, double> > seeds;
+        size_t start = 0;
+        while (start <= line.length()) {
+            size_t pos = line.find(delim, start);
+            if (pos == string::npos) {
+                pos = line.length();
+            }
+            string name = line.substr(start, pos - start);
+            trim(name);
+            size_t index = vertex_index(name, false);
+            if (index == IdMap::NOT_FOUND) {
+                error("Unknown seed vertex", name.c_str());
+            }
+            seeds.push_back(make_pair(index, 1.0));
+            start = pos + delim.length();
+        }
+        teleport.push_back(seeds);
+    }
+    return 0;
+}
+
+const vector<double>& Table::get_personalized_pagerank() {
+    return ppr;
+}
+
+const size_t Table::get_num_personalized() {
+    return num_personalized;
+}
+
+const void Table::print_personalized_v() {
+
+    write_lines(num_rows, [this](size_t i, string &out) {
+        append_node_name(out, i);
+        out += " =";
+        for (size_t s = 0; s < num_personalized; s++) {
+            out += ' ';
+            append_rank(out, ppr[i * num_personalized + s]);
+        }
+        out += '\n';
+    });
+}
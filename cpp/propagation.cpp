@@ -0,0 +1,352 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "table.h"
+#include "openmp.h"
+
+/*
+ * A bin of the push kernel spans this many blocks of REDUCE_BLOCK rows:
+ * 256 KB of sums, which fit in the L2 cache of current processors, and
+ * few enough rows for each to be numbered within its bin in 16 bits.
+ */
+static const size_t PUSH_BIN_BLOCKS = 8;
+static const size_t PUSH_BIN_ROWS = PUSH_BIN_BLOCKS * REDUCE_BLOCK;
+
+/* Bins are numbered in 16 bits too */
+static const size_t PUSH_MAX_BINS = 1 << 16;
+
+/* Assumed when the size of the last-level cache cannot be found */
+static const size_t DEFAULT_LLC_SIZE = 32 << 20;
+
+const char *kernel_name(IterationKernel k) {
+    switch (k) {
+    case KERNEL_PULL:
+        return "pull";
+    case KERNEL_PUSH:
+        return "push";
+    default:
+        return "auto";
+    }
+}
+
+bool parse_kernel(const char *name, IterationKernel &k) {
+    for (int i = KERNEL_AUTO; i <= KERNEL_PUSH; i++) {
+        if (!strcmp(name, kernel_name((IterationKernel) i))) {
+            k = (IterationKernel) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Returns the size in bytes of the last-level cache, from sysconf() or,
+ * failing that, from sysfs.
+ */
+static size_t last_level_cache() {
+    long size = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0) {
+        size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    }
+#endif
+    if (size <= 0) {
+        for (int index = 3; index >= 2 && size <= 0; index--) {
+            ifstream in("/sys/devices/system/cpu/cpu0/cache/index"
+                        + to_string(index) + "/size");
+            char unit = 0;
+            if (in >> size >> unit) {
+                size *= (unit == 'M') ? 1 << 20 : (unit == 'K') ? 1 << 10 : 1;
+            }
+        }
+    }
+    return size > 0 ? size : DEFAULT_LLC_SIZE;
+}
+
+bool Table::use_push_kernel(size_t rank_size) {
+    if (iteration_kernel == KERNEL_PULL
+        || num_rows > PUSH_MAX_BINS * PUSH_BIN_ROWS) {
+        return false;
+    }
+    if (iteration_kernel == KERNEL_PUSH) {
+        return true;
+    }
+    /* Only the pull kernel is placed on the NUMA nodes */
+    if (numa) {
+        return false;
+    }
+    static const size_t llc = last_level_cache();
+    return num_rows * rank_size > llc;
+}
+
+template <class Rank>
+void Table::iterate_push() {
+
+    double diff = 1;
+    double sum_pr;
+    double dangling_pr;
+    double one_Av, one_Iv;
+    num_iterations = 0;
+    RunStats::Mark start = stats.mark();
+
+    const size_t *offsets = row_offsets.data();
+    const size_t *links = in_links.data();
+    const size_t *outgoing = num_outgoing.data();
+    size_t num_arcs = offsets[num_rows];
+    size_t num_bins = (num_rows + PUSH_BIN_ROWS - 1) / PUSH_BIN_ROWS;
+    size_t num_blocks = (num_rows + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    vector<double> block_sum(num_blocks);
+    vector<double> block_dangling(num_blocks);
+    vector<double> block_diff(num_blocks);
+    vector<double> inv_outgoing(num_rows);
+
+    vector<uint16_t> arc_bin(num_arcs); // bin of each out-link, by column
+    vector<uint16_t> arc_row(num_arcs); // row in its bin of each pushed arc
+    vector<Rank> pushed(num_arcs); // contributions, bin after bin
+    vector<size_t> first_source; // the columns of each thread
+    vector<size_t> first_arc; // the out-links of each thread
+    vector<size_t> bin_start; // part t of bin b at bin_start[b * T + t]
+    size_t nthreads = 0;
+
+    /*
+     * The out-links of every column, in column order and by row within
+     * a column, with the bin and the row within the bin of each. The
+     * in-links are first appended to the bin of their column, where the
+     * arcs of its columns will go, and then put in column order one bin
+     * at a time, so that neither pass reads or writes at random.
+     */
+    vector<uint16_t> rows(num_arcs);
+    {
+        vector<uint16_t> column(num_arcs); // of each in-link, in its bin
+        vector<uint32_t> row(num_arcs); // of each in-link
+        vector<size_t> cursor(num_bins + 1);
+        for (size_t j = 0; j < num_rows; j++) {
+            cursor[j / PUSH_BIN_ROWS + 1] += outgoing[j];
+        }
+        for (size_t b = 0; b < num_bins; b++) {
+            cursor[b + 1] += cursor[b];
+        }
+        for (size_t i = 0; i < num_rows; i++) {
+            for (size_t k = offsets[i]; k < offsets[i + 1]; k++) {
+                size_t a = cursor[links[k] / PUSH_BIN_ROWS]++;
+                column[a] = links[k] % PUSH_BIN_ROWS;
+                row[a] = i;
+            }
+        }
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 1)
+        for (size_t b = 0; b < num_bins; b++) {
+            size_t first = b * PUSH_BIN_ROWS;
+            size_t last = min(first + PUSH_BIN_ROWS, num_rows);
+            size_t begin = b ? cursor[b - 1] : 0;
+            vector<size_t> next(last - first);
+            size_t a = begin;
+            for (size_t j = first; j < last; j++) {
+                next[j - first] = a;
+                a += outgoing[j];
+            }
+            for (size_t e = begin; e < cursor[b]; e++) {
+                a = next[column[e]]++;
+                arc_bin[a] = row[e] / PUSH_BIN_ROWS;
+                rows[a] = row[e] % PUSH_BIN_ROWS;
+            }
+        }
+    }
+
+    pr.assign(num_rows, 0);
+    for (size_t k = 0; k < num_rows; k++) {
+        inv_outgoing[k] = outgoing[k] ? 1.0 / outgoing[k] : 0.0;
+    }
+    pr[0] = 1;
+    sum_pr = 1;
+    dangling_pr = (outgoing[0] == 0) ? 1 : 0;
+    one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+    one_Iv = (1 - alpha) / num_rows;
+    RunStats::Mark binned;
+
+#pragma omp parallel num_threads(num_threads)
+    {
+        /*
+         * The columns are split so that the threads push about as many
+         * out-links each, and the part of each thread in every bin is
+         * laid out after those of the threads before it.
+         */
+#pragma omp single
+        {
+            nthreads = omp_get_num_threads();
+            first_source.assign(nthreads + 1, num_rows);
+            first_arc.assign(nthreads + 1, num_arcs);
+            first_source[0] = 0;
+            first_arc[0] = 0;
+            size_t t = 1;
+            size_t a = 0;
+            for (size_t j = 0; j < num_rows && t < nthreads; j++) {
+                a += outgoing[j];
+                while (t < nthreads && a * nthreads >= num_arcs * t) {
+                    first_source[t] = j + 1;
+                    first_arc[t++] = a;
+                }
+            }
+            bin_start.assign(num_bins * nthreads + 1, 0);
+        }
+
+        size_t t = omp_get_thread_num();
+        size_t arcs_begin = first_arc[t];
+        size_t arcs_end = first_arc[t + 1];
+        vector<size_t> cursor(num_bins); // where the next arc of a bin goes
+        vector<double> h(PUSH_BIN_ROWS); // the sums of the rows of a bin
+
+        for (size_t a = arcs_begin; a < arcs_end; a++) {
+            bin_start[arc_bin[a] * nthreads + t + 1]++;
+        }
+#pragma omp barrier
+#pragma omp single
+        for (size_t p = 0; p < num_bins * nthreads; p++) {
+            bin_start[p + 1] += bin_start[p];
+        }
+        for (size_t b = 0; b < num_bins; b++) {
+            cursor[b] = bin_start[b * nthreads + t];
+        }
+        for (size_t a = arcs_begin; a < arcs_end; a++) {
+            arc_row[cursor[arc_bin[a]]++] = rows[a];
+        }
+#pragma omp barrier
+#pragma omp single
+        {
+            vector<uint16_t>().swap(rows);
+            stats.add_phase("bin", start);
+            binned = stats.mark();
+            stats.start_iterations();
+        }
+
+        while (diff > convergence && num_iterations < max_iterations) {
+
+            /* Normalize, and push the contribution of every column */
+            for (size_t b = 0; b < num_bins; b++) {
+                cursor[b] = bin_start[b * nthreads + t];
+            }
+            size_t a = arcs_begin;
+            for (size_t j = first_source[t]; j < first_source[t + 1]; j++) {
+                pr[j] /= sum_pr;
+                Rank c = pr[j] * inv_outgoing[j];
+                for (size_t end = a + outgoing[j]; a < end; a++) {
+                    pushed[cursor[arc_bin[a]]++] = c;
+                }
+            }
+
+#pragma omp barrier
+
+#pragma omp for schedule(dynamic, 1)
+            for (size_t b = 0; b < num_bins; b++) {
+                size_t bin_first = b * PUSH_BIN_ROWS;
+                size_t bin_last = min(bin_first + PUSH_BIN_ROWS, num_rows);
+                fill(h.begin(), h.begin() + (bin_last - bin_first), 0.0);
+                for (size_t e = bin_start[b * nthreads];
+                     e < bin_start[(b + 1) * nthreads]; e++) {
+                    h[arc_row[e]] += pushed[e];
+                }
+                for (size_t first = bin_first; first < bin_last;
+                     first += REDUCE_BLOCK) {
+                    size_t last = min(first + REDUCE_BLOCK, num_rows);
+                    double bsum = 0;
+                    double bdangling = 0;
+                    double bdiff = 0;
+                    for (size_t i = first; i < last; i++) {
+                        double cpr = alpha * h[i - bin_first] + one_Av
+                            + one_Iv;
+                        bdiff += fabs(cpr - pr[i]);
+                        pr[i] = cpr;
+                        bsum += cpr;
+                        if (outgoing[i] == 0) {
+                            bdangling += cpr;
+                        }
+                    }
+                    size_t block = first / REDUCE_BLOCK;
+                    block_sum[block] = bsum;
+                    block_dangling[block] = bdangling;
+                    block_diff[block] = bdiff;
+                }
+            }
+
+#pragma omp single
+            {
+                diff = 0;
+                sum_pr = 0;
+                dangling_pr = 0;
+                for (size_t b = 0; b < num_blocks; b++) {
+                    diff += block_diff[b];
+                    sum_pr += block_sum[b];
+                    dangling_pr += block_dangling[b];
+                }
+                one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+                num_iterations++;
+                stats.add_iteration(diff, dangling_pr / sum_pr, num_arcs);
+                if (verbose) {
+                    cerr << "iteration " << num_iterations << " diff = "
+                         << diff << endl;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < num_rows; i++) {
+        pr[i] /= sum_pr;
+    }
+
+    stats.add_phase("iterate", binned);
+    double setup = chrono::duration<double>(binned.time
+                                            - start.time).count();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now()
+                                              - binned.time).count();
+    cerr << "power solver finished after " << num_iterations
+         << " iterations, diff = " << diff << ", "
+         << elapsed * 1000 / max(num_iterations, 1UL)
+         << " ms per iteration, pushing into " << num_bins << " bins of "
+         << PUSH_BIN_ROWS << " rows, binned in " << setup * 1000 << " ms"
+         << endl;
+}
+
+template void Table::iterate_push<float>();
+template void Table::iterate_push<double>();
@@ -0,0 +1,417 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <math.h>
+#include <string>
+#include <cstring>
+
+#include "table.h"
+#include "gather.h"
+
+/* Gorder places each vertex close to the last GORDER_WINDOW ones */
+static const size_t GORDER_WINDOW = 5;
+
+const char *reorder_name(Reorder r) {
+    switch (r) {
+    case REORDER_DEGREE:
+        return "degree";
+    case REORDER_RCM:
+        return "rcm";
+    case REORDER_GORDER:
+        return "gorder";
+    case REORDER_DANGLING:
+        return "dangling";
+    default:
+        return "none";
+    }
+}
+
+bool parse_reorder(const char *name, Reorder &r) {
+    for (int i = REORDER_NONE; i <= REORDER_DANGLING; i++) {
+        if (!strcmp(name, reorder_name((Reorder) i))) {
+            r = (Reorder) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * A priority queue of vertices keyed by small integers that only change
+ * by one at a time, as used by Gorder: vertices with equal keys are kept
+ * in a doubly linked list per key, so every operation but finding the
+ * top after decrements takes constant time.
+ */
+class UnitHeap {
+private:
+    static constexpr size_t NONE = (size_t) -1;
+    vector<size_t> key;
+    vector<size_t> prev, next;
+    vector<size_t> head; // first vertex with each key
+    vector<char> removed;
+    size_t top; // no vertex has a higher key
+
+    void unlink(size_t v) {
+        if (prev[v] != NONE) {
+            next[prev[v]] = next[v];
+        } else {
+            head[key[v]] = next[v];
+        }
+        if (next[v] != NONE) {
+            prev[next[v]] = prev[v];
+        }
+    }
+
+    void link(size_t v) {
+        if (key[v] >= head.size()) {
+            head.resize(2 * key[v] + 1, NONE);
+        }
+        prev[v] = NONE;
+        next[v] = head[key[v]];
+        if (next[v] != NONE) {
+            prev[next[v]] = v;
+        }
+        head[key[v]] = v;
+        top = max(top, key[v]);
+    }
+
+public:
+    UnitHeap(size_t n)
+        : key(n, 0), prev(n), next(n), head(1, NONE), removed(n, 0), top(0) {
+        /* Linked last to first, so that ties go to the lowest vertex */
+        for (size_t v = n; v-- > 0; ) {
+            link(v);
+        }
+    }
+
+    void increment(size_t v) {
+        if (!removed[v]) {
+            unlink(v);
+            key[v]++;
+            link(v);
+        }
+    }
+
+    void decrement(size_t v) {
+        if (!removed[v]) {
+            unlink(v);
+            key[v]--;
+            link(v);
+        }
+    }
+
+    void remove(size_t v) {
+        unlink(v);
+        removed[v] = 1;
+    }
+
+    /*
+     * Removes and returns a vertex with the highest key.
+     */
+    size_t pop() {
+        while (head[top] == NONE) {
+            top--;
+        }
+        size_t v = head[top];
+        remove(v);
+        return v;
+    }
+};
+
+size_t Table::vertex_degree(size_t v) {
+    return row_offsets[v + 1] - row_offsets[v] + num_outgoing[v];
+}
+
+void Table::order_by_degree(vector<size_t> &order) {
+    order.resize(num_rows);
+    for (size_t v = 0; v < num_rows; v++) {
+        order[v] = v;
+    }
+    /* Hubs first; their contributions are read most often */
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return vertex_degree(a) > vertex_degree(b);
+    });
+}
+
+void Table::order_by_rcm(vector<size_t> &order) {
+
+    vector<size_t> by_degree(num_rows);
+    for (size_t v = 0; v < num_rows; v++) {
+        by_degree[v] = v;
+    }
+    stable_sort(by_degree.begin(), by_degree.end(), [&](size_t a, size_t b) {
+        return vertex_degree(a) < vertex_degree(b);
+    });
+
+    order.clear();
+    order.reserve(num_rows);
+    vector<char> visited(num_rows, 0);
+    vector<size_t> neighbours;
+    auto by_degree_then_number = [&](size_t a, size_t b) {
+        size_t da = vertex_degree(a);
+        size_t db = vertex_degree(b);
+        return da < db || (da == db && a < b);
+    };
+
+    /*
+     * Cuthill-McKee: breadth first search of each component of the
+     * undirected graph, from a vertex of minimum degree, visiting the
+     * neighbours of each vertex by increasing degree
+     */
+    for (size_t s = 0; s < num_rows; s++) {
+        size_t start = by_degree[s];
+        if (visited[start]) {
+            continue;
+        }
+        visited[start] = 1;
+        size_t next = order.size();
+        order.push_back(start);
+        for (; next < order.size(); next++) {
+            size_t v = order[next];
+            neighbours.clear();
+            for (size_t k = row_offsets[v]; k < row_offsets[v + 1]; k++) {
+                if (!visited[in_links[k]]) {
+                    visited[in_links[k]] = 1;
+                    neighbours.push_back(in_links[k]);
+                }
+            }
+            for (size_t k = out_offsets[v]; k < out_offsets[v + 1]; k++) {
+                if (!visited[out_links[k]]) {
+                    visited[out_links[k]] = 1;
+                    neighbours.push_back(out_links[k]);
+                }
+            }
+            sort(neighbours.begin(), neighbours.end(), by_degree_then_number);
+            order.insert(order.end(), neighbours.begin(), neighbours.end());
+        }
+    }
+    reverse(order.begin(), order.end());
+}
+
+void Table::order_by_gorder(vector<size_t> &order) {
+
+    UnitHeap heap(num_rows);
+    /* Siblings through hubs are too many to count, and say little */
+    size_t hub = (size_t) sqrt((double) num_rows);
+
+    /*
+     * Scores the vertices that would share a window with v: its
+     * in- and out-neighbours, and those sharing an in-neighbour.
+     */
+    auto update = [&](size_t v, bool add) {
+        auto change = [&](size_t u) {
+            if (add) {
+                heap.increment(u);
+            } else {
+                heap.decrement(u);
+            }
+        };
+        for (size_t k = out_offsets[v]; k < out_offsets[v + 1]; k++) {
+            change(out_links[k]);
+        }
+        for (size_t k = row_offsets[v]; k < row_offsets[v + 1]; k++) {
+            size_t w = in_links[k];
+            change(w);
+            if (num_outgoing[w] > hub) {
+                continue;
+            }
+            for (size_t e = out_offsets[w]; e < out_offsets[w + 1]; e++) {
+                if (out_links[e] != v) {
+                    change(out_links[e]);
+                }
+            }
+        }
+    };
+
+    order.clear();
+    order.reserve(num_rows);
+    size_t start = 0;
+    for (size_t v = 1; v < num_rows; v++) {
+        if (row_offsets[v + 1] - row_offsets[v]
+            > row_offsets[start + 1] - row_offsets[start]) {
+            start = v;
+        }
+    }
+    heap.remove(start);
+    order.push_back(start);
+    update(start, true);
+    while (order.size() < num_rows) {
+        if (order.size() > GORDER_WINDOW) {
+            update(order[order.size() - GORDER_WINDOW - 1], false);
+        }
+        size_t v = heap.pop();
+        order.push_back(v);
+        update(v, true);
+    }
+}
+
+void Table::order_dangling_last(vector<size_t> &order) {
+    order.clear();
+    order.reserve(num_rows);
+    for (size_t v = 0; v < num_rows; v++) {
+        if (num_outgoing[v] > 0) {
+            order.push_back(v);
+        }
+    }
+    for (size_t v = 0; v < num_rows; v++) {
+        if (num_outgoing[v] == 0) {
+            order.push_back(v);
+        }
+    }
+}
+
+double Table::time_gather() {
+    vector<double> contrib(num_rows, 1.0 / num_rows);
+    vector<double> h(REDUCE_BLOCK);
+    const GatherKernel<size_t, double> &kernel =
+        best_gather_kernel<size_t, double>();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t first = 0; first < num_rows; first += REDUCE_BLOCK) {
+        kernel.gather_rows(contrib.data(), row_offsets.data(),
+                           in_links.data(), first,
+                           min(first + REDUCE_BLOCK, num_rows), h.data());
+    }
+    return chrono::duration<double>(chrono::steady_clock::now()
+                                    - start).count();
+}
+
+void Table::reorder_vertices(Reorder method) {
+
+    if (method == REORDER_NONE || num_rows == 0) {
+        return;
+    }
+    unpack_links();
+    bool follows_links = (method == REORDER_RCM || method == REORDER_GORDER);
+    if (follows_links && out_offsets.size() != num_rows + 1) {
+        build_out_links();
+    }
+
+    double before = time_gather();
+    RunStats::Mark start = stats.mark();
+
+    /* order[i] is the old number of new vertex i */
+    vector<size_t> order;
+    switch (method) {
+    case REORDER_DEGREE:
+        order_by_degree(order);
+        break;
+    case REORDER_RCM:
+        order_by_rcm(order);
+        break;
+    case REORDER_DANGLING:
+        order_dangling_last(order);
+        break;
+    default:
+        order_by_gorder(order);
+        break;
+    }
+    vector<size_t> renumber(num_rows);
+    for (size_t i = 0; i < num_rows; i++) {
+        renumber[order[i]] = i;
+    }
+
+    /* Renumber the rows and the in-links, keeping each row sorted */
+    vector<size_t> offsets(num_rows + 1);
+    vector<size_t> links(in_links.size());
+    vector<size_t> outgoing(num_rows);
+    for (size_t i = 0; i < num_rows; i++) {
+        size_t v = order[i];
+        size_t out = offsets[i];
+        for (size_t k = row_offsets[v]; k < row_offsets[v + 1]; k++) {
+            links[out++] = renumber[in_links[k]];
+        }
+        sort(links.begin() + offsets[i], links.begin() + out);
+        offsets[i + 1] = out;
+        outgoing[i] = num_outgoing[v];
+    }
+    row_offsets.clear();
+    row_offsets.edit().swap(offsets);
+    in_links.clear();
+    in_links.edit().swap(links);
+    num_outgoing.clear();
+    num_outgoing.edit().swap(outgoing);
+    out_offsets.clear();
+    out_links.clear();
+    drop_link_copies();
+    changed_sources.clear();
+    ppr.clear();
+    num_personalized = 0;
+
+    /*
+     * Vertices keep their names: string names are interned again in the
+     * new order, and numeric vertices are treated from now on as
+     * renumbered ones, with their original numbers in node_ids.
+     */
+    if (!numeric) {
+        StringPool names;
+        for (size_t i = 0; i < num_rows; i++) {
+            string_view name = node_names[order[i]];
+            names.intern(name.data(), name.size());
+        }
+        names.drop_index();
+        swap(node_names, names);
+    } else {
+        vector<uint64_t> ids(num_rows);
+        for (size_t i = 0; i < num_rows; i++) {
+            ids[i] = remap ? node_ids[order[i]] : order[i];
+        }
+        node_ids.clear();
+        node_ids.edit().swap(ids);
+        remap = true;
+        id_index.clear();
+    }
+    if (pr.size() == num_rows) {
+        vector<double> old_pr(pr);
+        for (size_t i = 0; i < num_rows; i++) {
+            pr[i] = old_pr[order[i]];
+        }
+    }
+
+    stats.add_phase("reorder", start);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now()
+                                              - start.time).count();
+    double after = time_gather();
+    cerr << "reordered " << num_rows << " vertices by "
+         << reorder_name(method) << " in " << elapsed << " s; gather pass "
+         << before * 1000 << " ms before, " << after * 1000 << " ms after";
+    if (after < before) {
+        cerr << ", pays off after " << ceil(elapsed / (before - after))
+             << " iterations";
+    }
+    cerr << endl;
+}
@@ -0,0 +1,657 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+#include <chrono>
+#include <thread>
+#include <cerrno>
+#include <math.h>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "table.h"
+#include "gather.h"
+
+/*
+ * Layout of a shard directory. The file "index" holds a ShardIndex
+ * header followed by the number of in-links of every shard, the number
+ * of outgoing links of every vertex, the original IDs of renumbered
+ * numeric vertices and the vertex names, in the layout of a snapshot's
+ * name sections. The in-links of rows
+ * [s * shard_rows, (s + 1) * shard_rows) are in the file "shard-<s>": a
+ * ShardHeader, the number of in-links of each row and then the in-links
+ * themselves, row by row and sorted, all as 32-bit values. Values are
+ * stored in the byte order and word size of the machine that wrote them.
+ */
+static const char INDEX_MAGIC[8] = { 'P', 'R', 'S', 'H', 'A', 'R', 'D', 'S' };
+static const char SHARD_MAGIC[8] = { 'P', 'R', 'S', 'H', 'A', 'R', 'D', 0 };
+static const uint32_t SHARDS_VERSION = 2;
+static const uint32_t SHARDS_BYTE_ORDER = 0x01020304;
+static const uint32_t SHARDS_NUMERIC = 1;
+static const uint32_t SHARDS_REMAP = 2;
+
+struct ShardIndex {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t word_size;
+    uint32_t flags;
+    uint64_t num_rows;
+    uint64_t num_arcs;
+    uint64_t num_names;
+    uint64_t shard_rows;
+    uint64_t num_shards;
+};
+
+struct ShardHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t first_row;
+    uint64_t num_rows;
+    uint64_t num_arcs;
+};
+
+/*
+ * An arc spilled to disk while the graph file is read, before its shard
+ * is sorted.
+ */
+struct SpilledArc {
+    uint64_t from;
+    uint64_t to;
+};
+
+/* Arcs buffered per shard before they are appended to its spill file */
+static const size_t SPILL_BUFFER = 4096;
+
+/* Shard files are read in chunks of this size */
+static const size_t READ_CHUNK = 16 << 20;
+
+static string shard_path(const string &dir, const char *name, size_t s) {
+    ostringstream path;
+    path << dir << '/' << name << '-' << s;
+    return path.str();
+}
+
+static string index_path(const string &dir) {
+    return dir + "/index";
+}
+
+/*
+ * Reads the whole file at path into buf, telling the kernel that it is
+ * read sequentially so that it reads ahead generously. Returns false if
+ * the file cannot be read.
+ */
+static bool read_whole(const string &path, vector<uint64_t> &buf,
+                       size_t &bytes) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    bytes = st.st_size;
+    buf.resize((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    char *p = (char *) buf.data();
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t n = read(fd, p + done, min(READ_CHUNK, bytes - done));
+        if (n <= 0) {
+            close(fd);
+            return false;
+        }
+        done += n;
+    }
+    close(fd);
+    return true;
+}
+
+int Table::shard_file(const string &filename, const string &dir,
+                      size_t rows) {
+
+    reset();
+    shard_rows = (max(rows, (size_t) 1) + REDUCE_BLOCK - 1)
+        / REDUCE_BLOCK * REDUCE_BLOCK;
+    if (mkdir(dir.c_str(), 0777) < 0 && errno != EEXIST) {
+        error("Cannot create directory", dir.c_str());
+    }
+
+    istream *infile;
+    ifstream file;
+    if (filename.empty()) {
+        infile = &cin;
+    } else {
+        file.open(filename.c_str());
+        if (!file.is_open()) {
+            error("Cannot open file", filename.c_str());
+        }
+        infile = &file;
+    }
+
+    /*
+     * First pass: read the graph file line by line and append every arc
+     * to the spill file of the shard of its destination. Only the vertex
+     * names or IDs are kept in memory.
+     */
+    vector<vector<SpilledArc> > spill;
+    vector<char> spilled; // the spill file has been started
+    auto flush = [&](size_t s) {
+        ofstream out(shard_path(dir, "spill", s).c_str(), ios::out
+                     | ios::binary | (spilled[s] ? ios::app : ios::trunc));
+        out.write((const char *) spill[s].data(),
+                  spill[s].size() * sizeof(SpilledArc));
+        if (out.fail()) {
+            error("Cannot write to directory", dir.c_str());
+        }
+        spilled[s] = true;
+        spill[s].clear();
+    };
+
+    RunStats::Mark start = stats.mark();
+    size_t linenum = 0;
+    string line;
+    while (getline(*infile, line)) {
+        size_t from, to;
+        if (parse_line(line, from, to)) {
+            if (numeric && remap) {
+                /* Renumber in order of first appearance, as remap_ids() */
+                size_t ids[2] = { from, to };
+                for (size_t &id : ids) {
+                    size_t v = id_index.find(id);
+                    if (v == IdMap::NOT_FOUND) {
+                        v = node_ids.size();
+                        id_index.insert(id, v);
+                        node_ids.edit().push_back(id);
+                    }
+                    id = v;
+                }
+                from = ids[0];
+                to = ids[1];
+            }
+            num_rows = max(num_rows, max(from, to) + 1);
+            size_t s = to / shard_rows;
+            if (s >= spill.size()) {
+                spill.resize(s + 1);
+                spilled.resize(s + 1, false);
+            }
+            spill[s].push_back(SpilledArc { from, to });
+            if (spill[s].size() == SPILL_BUFFER) {
+                flush(s);
+            }
+        }
+        linenum++;
+        if (linenum % 100000 == 0) {
+            report_progress(linenum);
+        }
+    }
+    report_progress(linenum);
+    node_names.drop_index();
+    id_index.clear();
+    if (num_rows > numeric_limits<uint32_t>::max()) {
+        error("Too many vertices for out-of-core shards in", dir.c_str());
+    }
+    stats.add_phase("parse", start);
+
+    /*
+     * Second pass: load one shard's arcs at a time, bucket them by
+     * destination, sort and deduplicate every row as build_graph() does,
+     * and write the shard. The outgoing links are counted on the way.
+     */
+    start = stats.mark();
+    size_t num_shards = (num_rows + shard_rows - 1) / shard_rows;
+    spill.resize(num_shards);
+    spilled.resize(num_shards, false);
+    vector<size_t> &outgoing = num_outgoing.edit();
+    outgoing.assign(num_rows, 0);
+    shard_arcs.assign(num_shards, 0);
+    size_t num_arcs = 0;
+    for (size_t s = 0; s < num_shards; s++) {
+        size_t first = s * shard_rows;
+        size_t rows = min(shard_rows, num_rows - first);
+        vector<SpilledArc> arcs;
+        if (spilled[s]) {
+            vector<uint64_t> buf;
+            size_t bytes;
+            string path = shard_path(dir, "spill", s);
+            if (!read_whole(path, buf, bytes)) {
+                error("Cannot read file", path.c_str());
+            }
+            const SpilledArc *p = (const SpilledArc *) buf.data();
+            arcs.assign(p, p + bytes / sizeof(SpilledArc));
+            unlink(path.c_str());
+        }
+        arcs.insert(arcs.end(), spill[s].begin(), spill[s].end());
+        vector<SpilledArc>().swap(spill[s]);
+
+        vector<size_t> offsets(rows + 1, 0);
+        for (const SpilledArc &arc : arcs) {
+            offsets[arc.to - first + 1]++;
+        }
+        for (size_t i = 0; i < rows; i++) {
+            offsets[i + 1] += offsets[i];
+        }
+        vector<uint32_t> links(arcs.size());
+        vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (const SpilledArc &arc : arcs) {
+            links[next[arc.to - first]++] = (uint32_t) arc.from;
+        }
+        vector<SpilledArc>().swap(arcs);
+
+        vector<uint32_t> degrees(rows);
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 1024)
+        for (size_t i = 0; i < rows; i++) {
+            uint32_t *begin = links.data() + offsets[i];
+            uint32_t *end = links.data() + offsets[i + 1];
+            sort(begin, end);
+            degrees[i] = unique(begin, end) - begin;
+        }
+        size_t out = 0;
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t k = offsets[i]; k < offsets[i] + degrees[i]; k++) {
+                links[out++] = links[k];
+                outgoing[links[k]]++;
+            }
+        }
+        links.resize(out);
+        num_arcs += out;
+        shard_arcs[s] = out;
+
+        ShardHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SHARD_MAGIC, sizeof(header.magic));
+        header.version = SHARDS_VERSION;
+        header.byte_order = SHARDS_BYTE_ORDER;
+        header.first_row = first;
+        header.num_rows = rows;
+        header.num_arcs = out;
+        string path = shard_path(dir, "shard", s);
+        ofstream shard(path.c_str(), ios::out | ios::binary | ios::trunc);
+        shard.write((const char *) &header, sizeof(header));
+        shard.write((const char *) degrees.data(), rows * sizeof(uint32_t));
+        shard.write((const char *) links.data(), out * sizeof(uint32_t));
+        shard.close();
+        if (shard.fail()) {
+            error("Cannot write file", path.c_str());
+        }
+    }
+
+    /* The index, with everything that is kept in memory */
+    bool remapped = numeric && remap;
+    size_t num_names = numeric ? 0 : node_names.size();
+    ShardIndex index;
+    memset(&index, 0, sizeof(index));
+    memcpy(index.magic, INDEX_MAGIC, sizeof(index.magic));
+    index.version = SHARDS_VERSION;
+    index.byte_order = SHARDS_BYTE_ORDER;
+    index.word_size = sizeof(size_t);
+    index.flags = (numeric ? SHARDS_NUMERIC : 0)
+        | (remapped ? SHARDS_REMAP : 0);
+    index.num_rows = num_rows;
+    index.num_arcs = num_arcs;
+    index.num_names = num_names;
+    index.shard_rows = shard_rows;
+    index.num_shards = num_shards;
+    string path = index_path(dir);
+    ofstream out(path.c_str(), ios::out | ios::binary | ios::trunc);
+    out.write((const char *) &index, sizeof(index));
+    out.write((const char *) shard_arcs.data(), num_shards * sizeof(size_t));
+    out.write((const char *) num_outgoing.data(), num_rows * sizeof(size_t));
+    if (remapped) {
+        out.write((const char *) node_ids.data(), num_rows * sizeof(uint64_t));
+    }
+    if (num_names) {
+        const MappedArray<size_t> &names_at = node_names.get_offsets();
+        out.write((const char *) names_at.data(),
+                  (num_names + 1) * sizeof(size_t));
+        out.write(node_names.get_arena().data(), names_at[num_names]);
+    }
+    out.close();
+    if (out.fail()) {
+        error("Cannot write file", path.c_str());
+    }
+
+    shard_dir = dir;
+    stats.add_phase("build", start);
+    cerr << "sharded " << num_rows << " vertices, " << num_arcs
+         << " arcs into " << num_shards << " shards of " << shard_rows
+         << " rows in " << dir << endl;
+
+    return 0;
+}
+
+int Table::load_shards(const string &dir) {
+
+    reset();
+    RunStats::Mark start = stats.mark();
+
+    string path = index_path(dir);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error("Cannot open file", path.c_str());
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(ShardIndex)) {
+        error("Not a pagerank shard index:", path.c_str());
+    }
+    size_t size = st.st_size;
+    void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        error("Cannot map file", path.c_str());
+    }
+    snapshot.reset(new FileMapping(addr, size));
+
+    ShardIndex index;
+    memcpy(&index, addr, sizeof(index));
+    if (memcmp(index.magic, INDEX_MAGIC, sizeof(index.magic))) {
+        error("Not a pagerank shard index:", path.c_str());
+    }
+    if (index.version != SHARDS_VERSION) {
+        error("Unsupported shard version in", path.c_str());
+    }
+    if (index.byte_order != SHARDS_BYTE_ORDER
+        || index.word_size != sizeof(size_t)) {
+        error("Shards written on an incompatible machine:", path.c_str());
+    }
+    bool remapped = index.flags & SHARDS_REMAP;
+    if (index.num_shards > size / sizeof(size_t)) {
+        error("Truncated or corrupt shard index", path.c_str());
+    }
+    size_t names_at = sizeof(index)
+        + (index.num_shards + index.num_rows) * sizeof(size_t)
+        + (remapped ? index.num_rows * sizeof(uint64_t) : 0);
+    size_t names_end = names_at;
+    if (index.num_names) {
+        names_end += (index.num_names + 1) * sizeof(size_t);
+        if (names_end > size) {
+            error("Truncated or corrupt shard index", path.c_str());
+        }
+        names_end += ((const size_t *) ((const char *) addr
+                                        + names_at))[index.num_names];
+    }
+    if (names_end != size || index.shard_rows == 0
+        || index.shard_rows % REDUCE_BLOCK
+        || index.num_shards != (index.num_rows + index.shard_rows - 1)
+                               / index.shard_rows) {
+        error("Truncated or corrupt shard index", path.c_str());
+    }
+
+    numeric = index.flags & SHARDS_NUMERIC;
+    remap = remapped;
+    num_rows = index.num_rows;
+    shard_rows = index.shard_rows;
+    const char *base = snapshot->data() + sizeof(index);
+    shard_arcs.assign((const size_t *) base,
+                      (const size_t *) base + index.num_shards);
+    base += index.num_shards * sizeof(size_t);
+    num_outgoing.attach((const size_t *) base, num_rows);
+    base += num_rows * sizeof(size_t);
+    if (remapped) {
+        node_ids.attach((const uint64_t *) base, num_rows);
+        base += num_rows * sizeof(uint64_t);
+    }
+    if (index.num_names) {
+        const size_t *name_offsets = (const size_t *) base;
+        base += (index.num_names + 1) * sizeof(size_t);
+        node_names.attach(base, name_offsets[index.num_names], name_offsets,
+                          index.num_names);
+    }
+    shard_dir = dir;
+    stats.add_phase("load", start);
+
+    cerr << "loaded " << num_rows << " vertices, " << index.num_arcs
+         << " arcs in " << index.num_shards << " shards from " << dir << endl;
+
+    return 0;
+}
+
+string Table::shard_name(size_t s) {
+    return shard_path(shard_dir, "shard", s);
+}
+
+bool Table::read_shard(size_t s, vector<uint64_t> &buf, size_t &bytes) {
+    return read_whole(shard_name(s), buf, bytes);
+}
+
+void Table::parse_shard(size_t s, const vector<uint64_t> &buf, size_t bytes,
+                        vector<size_t> &offsets, const uint32_t *&links) {
+    const ShardHeader *header = (const ShardHeader *) buf.data();
+    size_t first = s * shard_rows;
+    size_t rows = min(shard_rows, num_rows - first);
+    if (bytes < sizeof(ShardHeader)
+        || memcmp(header->magic, SHARD_MAGIC, sizeof(header->magic))
+        || header->first_row != first || header->num_rows != rows
+        || bytes != sizeof(ShardHeader)
+                    + (rows + header->num_arcs) * sizeof(uint32_t)) {
+        error("Truncated or corrupt shard", shard_name(s).c_str());
+    }
+    const uint32_t *degrees = (const uint32_t *) (header + 1);
+    links = degrees + rows;
+    offsets.resize(rows + 1);
+    offsets[0] = 0;
+    for (size_t i = 0; i < rows; i++) {
+        offsets[i + 1] = offsets[i] + degrees[i];
+    }
+}
+
+template <class Rank>
+void Table::sweep_rows(const Rank *contrib, const size_t *offsets,
+                       const uint32_t *links, size_t first, size_t rows,
+                       double *ranks, double one_Av, double one_Iv,
+                       double *block_sum, double *block_dangling,
+                       double *block_diff) {
+
+    const GatherKernel<uint32_t, Rank> &kernel =
+        best_gather_kernel<uint32_t, Rank>();
+    const size_t *outgoing = num_outgoing.data();
+    size_t num_blocks = (rows + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+
+#pragma omp parallel num_threads(num_threads)
+    {
+        vector<double> h(REDUCE_BLOCK);
+#pragma omp for schedule(dynamic, 1)
+        for (size_t lb = 0; lb < num_blocks; lb++) {
+            size_t bfirst = lb * REDUCE_BLOCK;
+            size_t blast = min(bfirst + REDUCE_BLOCK, rows);
+            double bsum = 0;
+            double bdangling = 0;
+            double bdiff = 0;
+            kernel.gather_rows(contrib, offsets, links, bfirst, blast,
+                               h.data());
+            for (size_t i = first + bfirst; i < first + blast; i++) {
+                double cpr = alpha * h[i - first - bfirst] + one_Av + one_Iv;
+                bdiff += fabs(cpr - ranks[i - first]);
+                ranks[i - first] = cpr;
+                bsum += cpr;
+                if (outgoing[i] == 0) {
+                    bdangling += cpr;
+                }
+            }
+            size_t b = first / REDUCE_BLOCK + lb;
+            block_sum[b] = bsum;
+            block_dangling[b] = bdangling;
+            block_diff[b] = bdiff;
+        }
+    }
+}
+
+template <class Rank>
+void Table::iterate_shards() {
+
+    double diff = 1;
+    double sum_pr;
+    double dangling_pr;
+    double one_Av, one_Iv;
+    num_iterations = 0;
+    RunStats::Mark start = stats.mark();
+    double read_wait = 0; // seconds spent waiting for shards to be read
+    size_t bytes_read = 0;
+    vector<Rank> contrib;
+    vector<double> inv_outgoing;
+
+    const size_t *outgoing = num_outgoing.data();
+    size_t num_shards = (num_rows + shard_rows - 1) / shard_rows;
+
+    /*
+     * The blocks of REDUCE_BLOCK rows never straddle two shards, so the
+     * sums are reduced exactly as in iterate().
+     */
+    size_t num_blocks = (num_rows + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    vector<double> block_sum(num_blocks);
+    vector<double> block_dangling(num_blocks);
+    vector<double> block_diff(num_blocks);
+
+    pr.assign(num_rows, 0);
+    contrib.resize(num_rows);
+    inv_outgoing.resize(num_rows);
+    for (size_t k = 0; k < num_rows; k++) {
+        inv_outgoing[k] = outgoing[k] ? 1.0 / outgoing[k] : 0.0;
+    }
+
+    pr[0] = 1;
+    sum_pr = 1;
+    dangling_pr = (outgoing[0] == 0) ? 1 : 0;
+    one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+    one_Iv = (1 - alpha) / num_rows;
+
+    /*
+     * While a shard is used, the next one is read into the other buffer
+     * on a thread of its own.
+     */
+    vector<uint64_t> buffers[2];
+    size_t sizes[2];
+    bool read_ok = false;
+    thread reader;
+    auto read_ahead = [&](size_t s, size_t into) {
+        reader = thread([this, s, into, &buffers, &sizes, &read_ok]() {
+            read_ok = read_shard(s, buffers[into], sizes[into]);
+        });
+    };
+    vector<size_t> offsets;
+    const uint32_t *links;
+
+    stats.start_iterations();
+    while (diff > convergence && num_iterations < max_iterations) {
+
+        size_t num_arcs = 0;
+        read_ahead(0, 0);
+
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+        for (size_t i = 0; i < num_rows; i++) {
+            pr[i] /= sum_pr;
+            contrib[i] = pr[i] * inv_outgoing[i];
+        }
+
+        for (size_t s = 0; s < num_shards; s++) {
+            chrono::steady_clock::time_point wait = chrono::steady_clock::now();
+            reader.join();
+            read_wait += chrono::duration<double>(chrono::steady_clock::now()
+                                                  - wait).count();
+            if (!read_ok) {
+                error("Cannot read file", shard_name(s).c_str());
+            }
+            size_t cur = s % 2;
+            if (s + 1 < num_shards) {
+                read_ahead(s + 1, 1 - cur);
+            }
+            bytes_read += sizes[cur];
+            parse_shard(s, buffers[cur], sizes[cur], offsets, links);
+            num_arcs += offsets.back();
+            size_t first = s * shard_rows;
+            sweep_rows(contrib.data(), offsets.data(), links, first,
+                       offsets.size() - 1, pr.data() + first, one_Av, one_Iv,
+                       block_sum.data(), block_dangling.data(),
+                       block_diff.data());
+        }
+
+        diff = 0;
+        sum_pr = 0;
+        dangling_pr = 0;
+        for (size_t b = 0; b < num_blocks; b++) {
+            diff += block_diff[b];
+            sum_pr += block_sum[b];
+            dangling_pr += block_dangling[b];
+        }
+        one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+        num_iterations++;
+        stats.add_iteration(diff, dangling_pr / sum_pr, num_arcs);
+        if (verbose) {
+            cerr << "iteration " << num_iterations << " diff = "
+                 << diff << endl;
+        }
+    }
+
+    for (size_t i = 0; i < num_rows; i++) {
+        pr[i] /= sum_pr;
+    }
+
+    stats.add_phase("iterate", start);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now()
+                                              - start.time).count();
+    size_t iterations = max(num_iterations, 1UL);
+    cerr << "out-of-core power solver finished after " << num_iterations
+         << " iterations, diff = " << diff << ", "
+         << elapsed * 1000 / iterations << " ms per iteration" << endl;
+    cerr << "read " << bytes_read / iterations << " bytes per iteration, "
+         << bytes_read / max(elapsed, 1e-9) / (1 << 20) << " MB/s, "
+         << read_wait * 1000 / iterations
+         << " ms per iteration waiting for reads" << endl;
+}
+
+template void Table::iterate_shards<float>();
+template void Table::iterate_shards<double>();
+template void Table::sweep_rows<float>(const float *, const size_t *,
+                                       const uint32_t *, size_t, size_t,
+                                       double *, double, double, double *,
+                                       double *, double *);
+template void Table::sweep_rows<double>(const double *, const size_t *,
+                                        const uint32_t *, size_t, size_t,
+                                        double *, double, double, double *,
+                                        double *, double *);
@@ -0,0 +1,320 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <limits>
+#include <cstddef>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "table.h"
+
+/*
+ * Layout of a snapshot file. A header at offset zero is followed by
+ * the sections listed below, each starting at a multiple of
+ * SNAPSHOT_ALIGN bytes so that it can be used in place once the file
+ * is mapped. All values are stored in the byte order and word size of
+ * the machine that wrote the file; both are recorded in the header and
+ * checked on loading.
+ */
+static const char SNAPSHOT_MAGIC[8] = { 'P', 'R', 'G', 'R', 'A', 'P', 'H', 0 };
+static const uint32_t SNAPSHOT_VERSION = 3;
+static const uint32_t SNAPSHOT_WIDE_VERSION = 2; // always 64-bit in-links
+static const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+static const uint64_t SNAPSHOT_ALIGN = 4096;
+static const uint32_t SNAPSHOT_NUMERIC = 1;
+static const uint32_t SNAPSHOT_REMAP = 2;
+static const uint32_t SNAPSHOT_NARROW = 4; // 32-bit in-links
+
+enum {
+    SECTION_OFFSETS, // row_offsets, num_rows + 1 entries
+    SECTION_LINKS, // in_links or narrow_links, num_arcs entries
+    SECTION_OUTGOING, // num_outgoing, num_rows entries
+    SECTION_NAME_OFFSETS, // num_names + 1 entries into SECTION_NAME_DATA
+    SECTION_NAME_DATA, // the vertex names, back to back
+    SECTION_NODE_IDS, // original IDs of renumbered numeric vertices
+    NUM_SECTIONS
+};
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t size; // in bytes, without padding
+    uint64_t checksum;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t word_size;
+    uint32_t flags;
+    uint64_t num_rows;
+    uint64_t num_arcs;
+    uint64_t num_names;
+    SnapshotSection sections[NUM_SECTIONS];
+    uint64_t header_checksum; // of all the preceding header bytes
+};
+
+/*
+ * A 64-bit multiplicative hash over 8-byte words; fast enough to run
+ * at memory speed over the largest sections.
+ */
+static uint64_t checksum(const char *p, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    uint64_t w;
+    size_t k;
+    for (k = 0; k + 8 <= n; k += 8) {
+        memcpy(&w, p + k, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+        h ^= h >> 29;
+    }
+    /* An empty section may have no data at all to copy from */
+    w = 0;
+    if (k < n) {
+        memcpy(&w, p + k, n - k);
+    }
+    h = (h ^ w) * 0x100000001b3ULL;
+    return h ^ n;
+}
+
+static uint64_t align_up(uint64_t n) {
+    return (n + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+}
+
+FileMapping::~FileMapping() {
+    munmap(addr, length);
+}
+
+int Table::save_binary(const string &filename) {
+
+    if (row_offsets.size() != num_rows + 1) {
+        build_graph();
+    }
+    /* The in-links are stored as they are iterated over */
+    bool narrow = (num_rows <= numeric_limits<uint32_t>::max());
+    size_t link_size = narrow ? sizeof(uint32_t) : sizeof(size_t);
+    if (narrow) {
+        narrow_links_in();
+    } else {
+        unpack_links();
+    }
+    size_t num_arcs = row_offsets.back();
+
+    /* The vertex names are stored as the arena of the string pool */
+    size_t num_names = numeric ? 0 : node_names.size();
+    const MappedArray<size_t> &names_at = node_names.get_offsets();
+    const MappedArray<char> &names = node_names.get_arena();
+
+    const char *section_data[NUM_SECTIONS] = {
+        (const char *) row_offsets.data(),
+        narrow ? (const char *) narrow_links.data()
+               : (const char *) in_links.data(),
+        (const char *) num_outgoing.data(),
+        (const char *) names_at.data(),
+        names.data(),
+        (const char *) node_ids.data()
+    };
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.word_size = sizeof(size_t);
+    bool remapped = numeric && remap;
+    header.flags = (numeric ? SNAPSHOT_NUMERIC : 0)
+        | (remapped ? SNAPSHOT_REMAP : 0)
+        | (narrow ? SNAPSHOT_NARROW : 0);
+    header.num_rows = num_rows;
+    header.num_arcs = num_arcs;
+    header.num_names = num_names;
+    header.sections[SECTION_OFFSETS].size = row_offsets.size() * sizeof(size_t);
+    header.sections[SECTION_LINKS].size = num_arcs * link_size;
+    header.sections[SECTION_OUTGOING].size =
+        num_outgoing.size() * sizeof(size_t);
+    if (num_names) {
+        header.sections[SECTION_NAME_OFFSETS].size =
+            (num_names + 1) * sizeof(size_t);
+        header.sections[SECTION_NAME_DATA].size = names_at[num_names];
+    }
+    if (remapped) {
+        header.sections[SECTION_NODE_IDS].size = num_rows * sizeof(uint64_t);
+    }
+
+    uint64_t offset = align_up(sizeof(header));
+    for (int s = 0; s < NUM_SECTIONS; s++) {
+        SnapshotSection &section = header.sections[s];
+        section.offset = offset;
+        section.checksum = checksum(section_data[s], section.size);
+        offset = align_up(offset + section.size);
+    }
+    header.header_checksum =
+        checksum((const char *) &header,
+                 offsetof(SnapshotHeader, header_checksum));
+
+    ofstream out(filename.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out.is_open()) {
+        error("Cannot open file", filename.c_str());
+    }
+    vector<char> padding(SNAPSHOT_ALIGN);
+    out.write((const char *) &header, sizeof(header));
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < NUM_SECTIONS; s++) {
+        const SnapshotSection &section = header.sections[s];
+        out.write(&padding[0], section.offset - written);
+        out.write(section_data[s], section.size);
+        written = section.offset + section.size;
+    }
+    out.write(&padding[0], align_up(written) - written);
+    out.close();
+    if (out.fail()) {
+        error("Cannot write file", filename.c_str());
+    }
+
+    cerr << "wrote " << num_rows << " vertices, " << num_arcs
+         << " arcs to " << filename << endl;
+
+    return 0;
+}
+
+int Table::load_binary(const string &filename, bool verify) {
+
+    reset();
+    RunStats::Mark start = stats.mark();
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error("Cannot open file", filename.c_str());
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(SnapshotHeader)) {
+        error("Not a pagerank snapshot:", filename.c_str());
+    }
+    size_t size = st.st_size;
+    void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        error("Cannot map file", filename.c_str());
+    }
+    snapshot.reset(new FileMapping(addr, size));
+
+    SnapshotHeader header;
+    memcpy(&header, addr, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic))
+        || header.header_checksum
+           != checksum((const char *) &header,
+                       offsetof(SnapshotHeader, header_checksum))) {
+        error("Not a pagerank snapshot:", filename.c_str());
+    }
+    if (header.version != SNAPSHOT_VERSION
+        && header.version != SNAPSHOT_WIDE_VERSION) {
+        error("Unsupported snapshot version in", filename.c_str());
+    }
+    if (header.byte_order != SNAPSHOT_BYTE_ORDER
+        || header.word_size != sizeof(size_t)) {
+        error("Snapshot written on an incompatible machine:",
+              filename.c_str());
+    }
+    for (int s = 0; s < NUM_SECTIONS; s++) {
+        const SnapshotSection &section = header.sections[s];
+        if (section.offset % SNAPSHOT_ALIGN
+            || section.offset > size || section.size > size - section.offset) {
+            error("Truncated or corrupt snapshot", filename.c_str());
+        }
+        if (verify && section.checksum
+            != checksum(snapshot->data() + section.offset, section.size)) {
+            error("Checksum mismatch in snapshot", filename.c_str());
+        }
+    }
+    bool narrow = (header.version != SNAPSHOT_WIDE_VERSION)
+        && (header.flags & SNAPSHOT_NARROW);
+    size_t link_size = narrow ? sizeof(uint32_t) : sizeof(size_t);
+    if (header.sections[SECTION_OFFSETS].size
+            != (header.num_rows + 1) * sizeof(size_t)
+        || header.sections[SECTION_LINKS].size
+            != header.num_arcs * link_size
+        || header.sections[SECTION_OUTGOING].size
+            != header.num_rows * sizeof(size_t)
+        || header.sections[SECTION_NAME_OFFSETS].size
+            != (header.num_names ? header.num_names + 1 : 0)
+               * sizeof(size_t)
+        || header.sections[SECTION_NODE_IDS].size
+            != ((header.flags & SNAPSHOT_REMAP) ? header.num_rows : 0)
+               * sizeof(uint64_t)) {
+        error("Truncated or corrupt snapshot", filename.c_str());
+    }
+
+    numeric = header.flags & SNAPSHOT_NUMERIC;
+    remap = header.flags & SNAPSHOT_REMAP;
+    num_rows = header.num_rows;
+    const char *base = snapshot->data();
+    row_offsets.attach((const size_t *)
+                       (base + header.sections[SECTION_OFFSETS].offset),
+                       num_rows + 1);
+    const char *links = base + header.sections[SECTION_LINKS].offset;
+    if (narrow) {
+        narrow_links.attach((const uint32_t *) links, header.num_arcs);
+    } else {
+        in_links.attach((const size_t *) links, header.num_arcs);
+    }
+    num_outgoing.attach((const size_t *)
+                        (base + header.sections[SECTION_OUTGOING].offset),
+                        num_rows);
+    if (header.num_names) {
+        node_names.attach(base + header.sections[SECTION_NAME_DATA].offset,
+                          header.sections[SECTION_NAME_DATA].size,
+                          (const size_t *)
+                          (base + header.sections[SECTION_NAME_OFFSETS].offset),
+                          header.num_names);
+    }
+    if (remap) {
+        node_ids.attach((const uint64_t *)
+                        (base + header.sections[SECTION_NODE_IDS].offset),
+                        num_rows);
+    }
+    stats.add_phase("load", start);
+
+    cerr << "loaded " << num_rows << " vertices, " << header.num_arcs
+         << " arcs from " << filename << endl;
+
+    return 0;
+}
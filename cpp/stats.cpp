@@ -0,0 +1,257 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "stats.h"
+
+using namespace std;
+
+size_t current_rss() {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL) {
+        return 0;
+    }
+    unsigned long size, resident;
+    int n = fscanf(f, "%lu %lu", &size, &resident);
+    fclose(f);
+    return n == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+size_t peak_rss() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    /* The kernel updates ru_maxrss lazily, so it can lag behind statm */
+    return max((size_t) usage.ru_maxrss * 1024, current_rss());
+}
+
+RunStats::Mark RunStats::mark() const {
+    Mark m;
+    m.time = now();
+    if (perf) {
+        m.counts = perf->read();
+    }
+    return m;
+}
+
+void RunStats::add_phase(const char *name, const Mark &start) {
+    Mark end = mark();
+    PhaseStats p;
+    p.name = name;
+    p.seconds = chrono::duration<double>(end.time - start.time).count();
+    p.rss_bytes = current_rss();
+    p.peak_rss_bytes = peak_rss();
+    p.counters = end.counts.since(start.counts);
+    phases.push_back(p);
+}
+
+void RunStats::start_iterations() {
+    iterations.clear();
+    nodes.clear();
+    last_iteration = mark();
+}
+
+void RunStats::add_iteration(double diff, double dangling, double edges) {
+    Mark end = mark();
+    IterationStats it;
+    it.diff = diff;
+    it.dangling = dangling;
+    it.seconds = chrono::duration<double>(end.time
+                                          - last_iteration.time).count();
+    it.edges_per_second = it.seconds > 0 ? edges / it.seconds : 0;
+    it.counters = end.counts.since(last_iteration.counts);
+    iterations.push_back(it);
+    last_iteration = end;
+}
+
+void RunStats::clear() {
+    phases.clear();
+    iterations.clear();
+    nodes.clear();
+}
+
+size_t RunStats::enable_counters() {
+    if (!perf) {
+        perf = make_shared<PerfCounters>();
+    }
+    return perf->num_available();
+}
+
+/*
+ * JSON has no infinities or NaNs.
+ */
+static void put_number(ostream &out, double x) {
+    if (isfinite(x)) {
+        out << x;
+    } else {
+        out << "null";
+    }
+}
+
+/*
+ * Writes counters as a JSON object, with null for the events that were
+ * not counted.
+ */
+static void put_counters(ostream &out, const PerfCounts &counters) {
+    out << ", \"counters\": {";
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        out << (e ? ", " : "") << "\"" << perf_event_name(e) << "\": ";
+        if (counters.valid[e]) {
+            out << counters.values[e];
+        } else {
+            out << "null";
+        }
+    }
+    out << "}";
+}
+
+void RunStats::write_json(ostream &out) const {
+    streamsize precision = out.precision(9);
+    out << "{\"phases\": [";
+    for (size_t k = 0; k < phases.size(); k++) {
+        const PhaseStats &p = phases[k];
+        out << (k ? ", " : "") << "{\"name\": \"" << p.name
+            << "\", \"seconds\": ";
+        put_number(out, p.seconds);
+        out << ", \"rss_bytes\": " << p.rss_bytes
+            << ", \"peak_rss_bytes\": " << p.peak_rss_bytes;
+        if (perf) {
+            put_counters(out, p.counters);
+        }
+        out << "}";
+    }
+    out << "], \"iterations\": [";
+    for (size_t k = 0; k < iterations.size(); k++) {
+        const IterationStats &it = iterations[k];
+        out << (k ? ", " : "") << "{\"iteration\": " << k + 1
+            << ", \"diff\": ";
+        put_number(out, it.diff);
+        out << ", \"dangling\": ";
+        put_number(out, it.dangling);
+        out << ", \"seconds\": ";
+        put_number(out, it.seconds);
+        out << ", \"edges_per_s\": ";
+        put_number(out, it.edges_per_second);
+        if (perf) {
+            put_counters(out, it.counters);
+        }
+        out << "}";
+    }
+    out << "]";
+    if (!nodes.empty()) {
+        out << ", \"nodes\": [";
+        for (size_t k = 0; k < nodes.size(); k++) {
+            const NodeStats &n = nodes[k];
+            out << (k ? ", " : "") << "{\"node\": " << n.node
+                << ", \"threads\": " << n.threads
+                << ", \"rows\": " << n.rows
+                << ", \"in_links\": " << n.in_links
+                << ", \"bytes_per_iteration\": ";
+            put_number(out, n.bytes_per_iteration);
+            out << ", \"bytes_per_s\": ";
+            put_number(out, n.bytes_per_second);
+            out << "}";
+        }
+        out << "]";
+    }
+    out << ", \"peak_rss_bytes\": " << peak_rss() << "}" << endl;
+    out.precision(precision);
+}
+
+/*
+ * Writes one row of the table of write_counters().
+ */
+static void put_counter_row(ostream &out, const string &label,
+                            const PerfCounts &c) {
+    out << left << setw(14) << label << right;
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        out << setw(18);
+        if (c.valid[e]) {
+            out << c.values[e];
+        } else {
+            out << "-";
+        }
+    }
+    const uint64_t *v = c.values;
+    out << fixed << setprecision(2) << setw(7);
+    if (c.valid[PERF_CYCLES] && c.valid[PERF_INSTRUCTIONS]
+        && v[PERF_CYCLES]) {
+        out << (double) v[PERF_INSTRUCTIONS] / v[PERF_CYCLES];
+    } else {
+        out << "-";
+    }
+    for (int e : { PERF_LLC_MISSES, PERF_DTLB_MISSES, PERF_BRANCH_MISSES }) {
+        out << setw(8);
+        if (c.valid[e] && c.valid[PERF_INSTRUCTIONS]
+            && v[PERF_INSTRUCTIONS]) {
+            out << 1000.0 * v[e] / v[PERF_INSTRUCTIONS];
+        } else {
+            out << "-";
+        }
+    }
+    out << defaultfloat << endl;
+}
+
+void RunStats::write_counters(ostream &out) const {
+    if (!perf || perf->num_available() == 0) {
+        out << "hardware counters unavailable";
+        if (perf && perf->get_errno()) {
+            out << ": " << strerror(perf->get_errno());
+        }
+        out << endl;
+        return;
+    }
+    streamsize precision = out.precision();
+    out << left << setw(14) << "phase" << right;
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        out << setw(18) << perf_event_name(e);
+    }
+    out << setw(7) << "IPC" << setw(8) << "LLC/ki" << setw(8) << "TLB/ki"
+        << setw(8) << "br/ki" << endl;
+    for (const PhaseStats &p : phases) {
+        put_counter_row(out, p.name, p.counters);
+    }
+    for (size_t k = 0; k < iterations.size(); k++) {
+        put_counter_row(out, "iteration " + to_string(k + 1),
+                        iterations[k].counters);
+    }
+    out.precision(precision);
+}
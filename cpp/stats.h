@@ -0,0 +1,190 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <chrono>
+#include <memory>
+#include <cstddef>
+
+#include "perf_counters.h"
+
+/*
+ * The time and memory taken by a phase of the work of a Table, such as
+ * parsing the graph file or iterating.
+ */
+struct PhaseStats {
+    std::string name;
+    double seconds;
+    size_t rss_bytes; // resident set size at the end of the phase
+    size_t peak_rss_bytes; // largest resident set size so far
+    PerfCounts counters; // hardware events, if counters are enabled
+};
+
+/*
+ * One iteration of a pagerank calculation.
+ */
+struct IterationStats {
+    double diff; // L1 difference from the previous iteration
+    double dangling; // pagerank of the dangling vertices, normalised
+    double seconds;
+    double edges_per_second; // in-links gathered per second
+    PerfCounts counters; // hardware events, if counters are enabled
+};
+
+/*
+ * The share of the iterations of a calculation on one NUMA node. The
+ * bytes are estimated from the rows and in-links the threads of the
+ * node gather, as the memory controllers cannot be read per process.
+ */
+struct NodeStats {
+    int node; // the number of the node in sysfs
+    size_t threads;
+    size_t rows;
+    size_t in_links;
+    double bytes_per_iteration; // read and written by the node's threads
+    double bytes_per_second; // over all the iterations
+};
+
+/*
+ * Statistics collected while a Table reads a graph and calculates its
+ * pagerank. Collecting them costs a clock reading per phase and per
+ * iteration and a read of /proc/self/statm per phase, so it is always
+ * on.
+ */
+class RunStats {
+public:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    /*
+     * The clock and the hardware counters at the start of a phase.
+     */
+    struct Mark {
+        time_point time;
+        PerfCounts counts;
+    };
+
+private:
+    std::vector<PhaseStats> phases;
+    std::vector<IterationStats> iterations;
+    std::vector<NodeStats> nodes; // empty unless threads are placed
+    Mark last_iteration;
+    std::shared_ptr<PerfCounters> perf; // null unless counters are enabled
+
+public:
+    static time_point now() { return std::chrono::steady_clock::now(); }
+
+    /*
+     * Returns the clock and the counters now, for add_phase().
+     */
+    Mark mark() const;
+
+    /*
+     * Records that the phase called name ran from start until now.
+     */
+    void add_phase(const char *name, const Mark &start);
+
+    /*
+     * Starts the clock for the iterations of a calculation, discarding
+     * those of any earlier one.
+     */
+    void start_iterations();
+
+    /*
+     * Records an iteration that ended now and gathered edges in-links.
+     */
+    void add_iteration(double diff, double dangling, double edges);
+
+    const std::vector<PhaseStats> &get_phases() const { return phases; }
+    const std::vector<IterationStats> &get_iterations() const {
+        return iterations;
+    }
+
+    /*
+     * Records how the work of the last calculation was spread over the
+     * NUMA nodes.
+     */
+    void set_nodes(const std::vector<NodeStats> &n) { nodes = n; }
+    const std::vector<NodeStats> &get_nodes() const { return nodes; }
+
+    /*
+     * Discards the statistics collected so far; the counters stay
+     * enabled.
+     */
+    void clear();
+
+    /*
+     * Opens the hardware counters, so that the events of every phase
+     * and iteration from now on are counted too. Returns the number of
+     * events that can be counted, which is 0 when perf events are not
+     * supported or not permitted; the statistics are then collected
+     * without them.
+     */
+    size_t enable_counters();
+
+    /*
+     * Returns the counters, or null if they are not enabled.
+     */
+    const PerfCounters *get_counters() const { return perf.get(); }
+
+    /*
+     * Writes the statistics as a JSON object.
+     */
+    void write_json(std::ostream &out) const;
+
+    /*
+     * Writes the hardware events of every phase and iteration as a
+     * table, with the instructions per cycle and the misses per
+     * thousand instructions.
+     */
+    void write_counters(std::ostream &out) const;
+};
+
+/*
+ * Returns the current resident set size of the process, in bytes, or 0
+ * if it cannot be found out.
+ */
+size_t current_rss();
+
+/*
+ * Returns the largest resident set size of the process so far, in
+ * bytes.
+ */
+size_t peak_rss();
+
+#endif
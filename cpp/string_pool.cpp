@@ -0,0 +1,145 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstring>
+#include <algorithm>
+
+#include "string_pool.h"
+
+using namespace std;
+
+/* The hash table is kept at most half full */
+static const size_t MIN_CAPACITY = 1024;
+
+StringPool::StringPool() {
+    clear();
+}
+
+uint64_t StringPool::hash(const char *s, size_t len) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+    uint64_t w;
+    size_t k;
+    for (k = 0; k + 8 <= len; k += 8) {
+        memcpy(&w, s + k, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    /* An empty string may have no characters at all to copy from */
+    w = 0;
+    if (k < len) {
+        memcpy(&w, s + k, len - k);
+    }
+    h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 29);
+}
+
+void StringPool::rehash(size_t capacity) {
+    slots.assign(capacity, 0);
+    slot_tags.assign(capacity, 0);
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < size(); i++) {
+        string_view name = (*this)[i];
+        uint64_t h = hash(name.data(), name.size());
+        size_t slot = h & mask;
+        while (slots[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = i + 1;
+        slot_tags[slot] = h >> 32;
+    }
+}
+
+size_t StringPool::probe(const char *s, size_t len, uint64_t h) {
+
+    size_t capacity = max(MIN_CAPACITY, slots.size());
+    while (capacity < 2 * (size() + 1)) {
+        capacity *= 2;
+    }
+    if (capacity != slots.size()) {
+        rehash(capacity);
+    }
+
+    size_t mask = slots.size() - 1;
+    uint32_t tag = h >> 32;
+    size_t slot = h & mask;
+    while (slots[slot]) {
+        if (slot_tags[slot] == tag) {
+            size_t i = slots[slot] - 1;
+            if (offsets[i + 1] - offsets[i] == len
+                && memcmp(arena.data() + offsets[i], s, len) == 0) {
+                return slot;
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+size_t StringPool::intern(const char *s, size_t len, uint64_t h) {
+    size_t slot = probe(s, len, h);
+    if (slots[slot]) {
+        return slots[slot] - 1;
+    }
+    size_t index = size();
+    vector<char> &a = arena.edit();
+    a.insert(a.end(), s, s + len);
+    offsets.edit().push_back(a.size());
+    slots[slot] = index + 1;
+    slot_tags[slot] = h >> 32;
+    return index;
+}
+
+size_t StringPool::find(const char *s, size_t len) {
+    size_t slot = probe(s, len, hash(s, len));
+    return slots[slot] ? slots[slot] - 1 : NOT_FOUND;
+}
+
+void StringPool::drop_index() {
+    vector<size_t>().swap(slots);
+    vector<uint32_t>().swap(slot_tags);
+}
+
+void StringPool::clear() {
+    arena.clear();
+    offsets.clear();
+    offsets.edit().push_back(0);
+    drop_index();
+}
+
+void StringPool::attach(const char *a, size_t arena_size, const size_t *o,
+                        size_t n) {
+    drop_index();
+    arena.attach(a, arena_size);
+    offsets.attach(o, n + 1);
+}
@@ -0,0 +1,131 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <vector>
+#include <string_view>
+#include <cstddef>
+#include <stdint.h>
+
+#include "mapped_array.h"
+
+/*
+ * Interns strings, numbering them from zero in order of first
+ * appearance. The strings are stored once, back to back, in a single
+ * growing arena; string i is found through an offset into it, so
+ * looking up a string by its number takes constant time. Looking up a
+ * number by its string uses an open addressing hash table with linear
+ * probing, which can be dropped when no more strings will be added.
+ */
+class StringPool {
+private:
+    MappedArray<char> arena; // the strings, back to back
+    MappedArray<size_t> offsets; // string i is arena[offsets[i]..[i + 1])
+    std::vector<size_t> slots; // hash table: string number + 1, or 0 if empty
+    std::vector<uint32_t> slot_tags; // upper hash bits of the string in a slot
+
+    void rehash(size_t capacity);
+
+    /*
+     * Returns the slot that holds the len characters at s, or the empty
+     * slot where they would be inserted. h must be hash(s, len).
+     */
+    size_t probe(const char *s, size_t len, uint64_t h);
+
+public:
+    static constexpr size_t NOT_FOUND = (size_t) -1;
+
+    StringPool();
+
+    /*
+     * Returns a hash of the len characters at s, as used by intern().
+     * It is exposed so that callers can hash strings in parallel
+     * before interning them in order.
+     */
+    static uint64_t hash(const char *s, size_t len);
+
+    /*
+     * Returns the number of the len characters at s, adding them to
+     * the pool if they have not been seen before. h must be hash(s, len).
+     */
+    size_t intern(const char *s, size_t len, uint64_t h);
+
+    size_t intern(const char *s, size_t len) {
+        return intern(s, len, hash(s, len));
+    }
+
+    /*
+     * Returns the number of the len characters at s, or NOT_FOUND if
+     * they are not in the pool. Rebuilds the hash table if it has been
+     * dropped.
+     */
+    size_t find(const char *s, size_t len);
+
+    /*
+     * Returns the number of strings in the pool.
+     */
+    size_t size() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    /*
+     * Returns string i. The view is valid until the next call to intern().
+     */
+    std::string_view operator[](size_t i) const {
+        return std::string_view(arena.data() + offsets[i],
+                           offsets[i + 1] - offsets[i]);
+    }
+
+    /*
+     * Releases the hash table. The strings remain available by number;
+     * the table is rebuilt if intern() is called again.
+     */
+    void drop_index();
+
+    void clear();
+
+    /*
+     * Makes the pool refer to n strings stored elsewhere (typically in
+     * a mapped snapshot) in the same layout as get_arena() and
+     * get_offsets(), which have n + 1 entries.
+     */
+    void attach(const char *a, size_t arena_size, const size_t *o, size_t n);
+
+    const MappedArray<char> &get_arena() const { return arena; }
+    const MappedArray<size_t> &get_offsets() const { return offsets; }
+};
+
+#endif
@@ -42,15 +42,34 @@
 #include <string>
 #include <cstring>
 #include <limits>
+#include <chrono>
 
 #include "table.h"
+#include "openmp.h"
+#include "gather.h"
+#include "group_varint.h"
+#include "numa.h"
 
 void Table::reset() {
+    num_rows = 0;
     num_outgoing.clear();
-    rows.clear();
-    nodes_to_idx.clear();
-    idx_to_nodes.clear();
+    row_offsets.clear();
+    in_links.clear();
+    pending_arcs.clear();
+    node_names.clear();
+    node_ids.clear();
+    snapshot.reset();
+    out_offsets.clear();
+    out_links.clear();
+    drop_link_copies();
+    changed_sources.clear();
+    id_index.clear();
+    shard_dir.clear();
+    shard_arcs.clear();
+    stats.clear();
     pr.clear();
+    num_personalized = 0;
+    ppr.clear();
 }
 
 Table::Table(double a, double c, size_t i, bool t, bool n, string d)
@@ -59,21 +78,62 @@ Table::Table(double a, double c, size_t i, bool t, bool n, string d)
       convergence(c),
       max_iterations(i),
       delim(d),
-      numeric(n) {
+      numeric(n),
+      remap(DEFAULT_REMAP),
+      num_threads(DEFAULT_THREADS),
+      solver(DEFAULT_SOLVER),
+      omega(DEFAULT_OMEGA),
+      extrapolation(DEFAULT_EXTRAPOLATION),
+      extrapolation_period(DEFAULT_EXTRAPOLATION_PERIOD),
+      lump_dangling(false),
+      iteration_kernel(DEFAULT_KERNEL),
+      numa(false),
+      numa_replicate(false),
+      verbose(false),
+      float_ranks(DEFAULT_FLOAT_RANKS),
+      compress(DEFAULT_COMPRESS),
+      num_rows(0),
+      shard_rows(DEFAULT_SHARD_ROWS),
+      num_iterations(0),
+      num_personalized(0) {
 }
 
 void Table::reserve(size_t size) {
-    num_outgoing.reserve(size);
-    rows.reserve(size);
+    num_outgoing.edit().reserve(size);
+    row_offsets.edit().reserve(size + 1);
 }
 
 const size_t Table::get_num_rows() {
-    return rows.size();
+    return num_rows;
 }
 
-void Table::set_num_rows(size_t num_rows) {
-    num_outgoing.resize(num_rows);
-    rows.resize(num_rows);
+const size_t Table::get_num_arcs() {
+    return row_offsets.empty() ? 0 : row_offsets.back();
+}
+
+const unsigned long Table::get_num_iterations() {
+    return num_iterations;
+}
+
+const RunStats& Table::get_stats() {
+    return stats;
+}
+
+size_t Table::enable_perf_counters() {
+    return stats.enable_counters();
+}
+
+void Table::set_num_rows(size_t n) {
+    unpack_links();
+    num_rows = n;
+    num_outgoing.edit().resize(num_rows);
+    if (!row_offsets.empty()) {
+        size_t num_arcs = row_offsets.back();
+        row_offsets.edit().resize(num_rows + 1, num_arcs);
+    }
+    out_offsets.clear();
+    out_links.clear();
+    drop_link_copies();
 }
 
 const void Table::error(const char *p,const char *p2) {
@@ -112,15 +172,163 @@ const vector<double>& Table::get_pagerank() {
 const string Table::get_node_name(size_t index) {
     if (numeric) {
         stringstream s;
-        s << index;
+        if (remap) {
+            s << node_ids[index];
+        } else {
+            s << index;
+        }
         return s.str();
+    } else if (index < node_names.size()) {
+        return string(node_names[index]);
     } else {
-        return idx_to_nodes[index];
+        return string();
+    }
+}
+
+const StringPool& Table::get_mapping() {
+    return node_names;
+}
+
+const size_t Table::get_num_threads() {
+    return num_threads;
+}
+
+void Table::set_num_threads(size_t n) {
+    num_threads = n ? n : 1;
+}
+
+const Solver Table::get_solver() {
+    return solver;
+}
+
+void Table::set_solver(Solver s) {
+    solver = s;
+}
+
+const double Table::get_omega() {
+    return omega;
+}
+
+void Table::set_omega(double w) {
+    omega = w;
+}
+
+const Extrapolation Table::get_extrapolation() {
+    return extrapolation;
+}
+
+void Table::set_extrapolation(Extrapolation e) {
+    extrapolation = e;
+}
+
+const size_t Table::get_extrapolation_period() {
+    return extrapolation_period;
+}
+
+void Table::set_extrapolation_period(size_t p) {
+    extrapolation_period = p;
+}
+
+const bool Table::get_lump_dangling() {
+    return lump_dangling;
+}
+
+void Table::set_lump_dangling(bool l) {
+    lump_dangling = l;
+}
+
+const IterationKernel Table::get_iteration_kernel() {
+    return iteration_kernel;
+}
+
+void Table::set_iteration_kernel(IterationKernel k) {
+    iteration_kernel = k;
+}
+
+const bool Table::get_numa() {
+    return numa;
+}
+
+void Table::set_numa(bool n) {
+    numa = n;
+    if (!n) {
+        numa_replicate = false;
+    }
+}
+
+const bool Table::get_numa_replicate() {
+    return numa_replicate;
+}
+
+void Table::set_numa_replicate(bool r) {
+    numa_replicate = r;
+    if (r) {
+        numa = true;
+    }
+}
+
+const bool Table::get_float_ranks() {
+    return float_ranks;
+}
+
+void Table::set_float_ranks(bool f) {
+    float_ranks = f;
+}
+
+const bool Table::get_compress() {
+    return compress;
+}
+
+void Table::set_compress(bool c) {
+    compress = c;
+}
+
+const bool Table::get_verbose() {
+    return verbose;
+}
+
+void Table::set_verbose(bool v) {
+    verbose = v;
+}
+
+const char *solver_name(Solver s) {
+    switch (s) {
+    case SOLVER_GAUSS_SEIDEL:
+        return "gs";
+    case SOLVER_SOR:
+        return "sor";
+    default:
+        return "power";
+    }
+}
+
+bool parse_solver(const char *name, Solver &s) {
+    for (int i = SOLVER_POWER; i <= SOLVER_SOR; i++) {
+        if (!strcmp(name, solver_name((Solver) i))) {
+            s = (Solver) i;
+            return true;
+        }
     }
+    return false;
 }
 
-const map<size_t, string>& Table::get_mapping() {
-    return idx_to_nodes;
+const char *extrapolation_name(Extrapolation e) {
+    switch (e) {
+    case EXTRAPOLATE_QUADRATIC:
+        return "quadratic";
+    default:
+        return "none";
+    }
+}
+
+bool parse_extrapolation(const char *name, Extrapolation &e) {
+    for (int i = EXTRAPOLATE_NONE; i <= EXTRAPOLATE_QUADRATIC; i++) {
+        if (!strcmp(name, extrapolation_name((Extrapolation) i))) {
+            e = (Extrapolation) i;
+            return true;
+        }
+    }
+    return false;
 }
 
 const bool Table::get_trace() {
@@ -139,6 +347,14 @@ void Table::set_numeric(bool n) {
     numeric = n;
 }
 
+const bool Table::get_remap() {
+    return remap;
+}
+
+void Table::set_remap(bool r) {
+    remap = r;
+}
+
 const string Table::get_delim() {
     return delim;
 }
@@ -162,25 +378,51 @@ void Table::trim(string &str) {
 }
 
 size_t Table::insert_mapping(const string &key) {
+    return node_names.intern(key.data(), key.size());
+}
 
-    size_t index = 0;
-    map<string, size_t>::const_iterator i = nodes_to_idx.find(key);
-    if (i != nodes_to_idx.end()) {
-        index = i->second;
+bool Table::parse_line(const string &line, size_t &from_idx,
+                       size_t &to_idx) {
+    size_t pos = line.find(delim);
+    if (pos == string::npos) {
+        return false;
+    }
+    string from = line.substr(0, pos);
+    trim(from);
+    if (!numeric) {
+        from_idx = insert_mapping(from);
+    } else if (remap) {
+        from_idx = strtoull(from.c_str(), NULL, 10);
     } else {
-        index = nodes_to_idx.size();
-        nodes_to_idx.insert(pair<string, size_t>(key, index));
-        idx_to_nodes.insert(pair<size_t, string>(index, key));;
+        from_idx = strtol(from.c_str(), NULL, 10);
     }
-
-    return index;
+    string to = line.substr(pos + delim.length());
+    trim(to);
+    if (!numeric) {
+        to_idx = insert_mapping(to);
+    } else if (remap) {
+        to_idx = strtoull(to.c_str(), NULL, 10);
+    } else {
+        to_idx = strtol(to.c_str(), NULL, 10);
+    }
+    return true;
 }
 
-int Table::read_file(const string &filename) {
-
-    pair<map<string, size_t>::iterator, bool> ret;
+int Table::read_file(const string &filename, bool build) {
 
     reset();
+
+    /* Tracing needs the arcs to be added one by one, in order */
+    if (!filename.empty() && !trace && read_mapped(filename)) {
+        node_names.drop_index();
+        if (numeric && remap) {
+            remap_ids();
+        }
+        if (build) {
+            build_graph();
+        }
+        return 0;
+    }
     
     istream *infile;
 
@@ -193,216 +435,957 @@ int Table::read_file(const string &filename) {
       }
     }
     
-    size_t delim_len = delim.length();
+    /* Names are interned as they are parsed */
+    RunStats::Mark start = stats.mark();
     size_t linenum = 0;
     string line; // current line
     while (getline(*infile, line)) {
-        string from, to; // from and to fields
         size_t from_idx, to_idx; // indices of from and to nodes
-        size_t pos = line.find(delim);
-        if (pos != string::npos) {
-            from = line.substr(0, pos);
-            trim(from);
-            if (!numeric) {
-                from_idx = insert_mapping(from);
-            } else {
-                from_idx = strtol(from.c_str(), NULL, 10);
-            }
-            to = line.substr(pos + delim_len);
-            trim(to);
-            if (!numeric) {
-                to_idx = insert_mapping(to);
-            } else {
-                to_idx = strtol(to.c_str(), NULL, 10);
-            }
+        if (parse_line(line, from_idx, to_idx)) {
             add_arc(from_idx, to_idx);
         }
 
         linenum++;
         if (linenum && ((linenum % 100000) == 0)) {
-            cerr << "read " << linenum << " lines, "
-                 << rows.size() << " vertices" << endl;
+            report_progress(linenum);
         }
 
-        from.clear();
-        to.clear();
         line.clear();
     }
 
-    cerr << "read " << linenum << " lines, "
-         << rows.size() << " vertices" << endl;
+    stats.add_phase("parse", start);
+    report_progress(linenum);
 
-    nodes_to_idx.clear();
+    node_names.drop_index();
 
     if (infile != &cin) {
         delete infile;
     }
-    reserve(idx_to_nodes.size());
+
+    if (numeric && remap) {
+        remap_ids();
+    }
+
+    if (build) {
+        build_graph();
+    }
     
     return 0;
 }
 
-/*
- * Taken from: M. H. Austern, "Why You Shouldn't Use set - and What You Should
- * Use Instead", C++ Report 12:4, April 2000.
- */
-template <class Vector, class T>
-bool Table::insert_into_vector(Vector& v, const T& t) {
-    typename Vector::iterator i = lower_bound(v.begin(), v.end(), t);
-    if (i == v.end() || t < *i) {
-        v.insert(i, t);
-        return true;
-    } else {
-        return false;
+void Table::report_progress(size_t linenum) {
+    cerr << "read " << linenum << " lines";
+    /* Until renumbered, vertex IDs say nothing about their number */
+    if (!(numeric && remap)) {
+        cerr << ", " << num_rows << " vertices";
     }
+    cerr << endl;
 }
 
-bool Table::add_arc(size_t from, size_t to) {
+void Table::add_arc(size_t from, size_t to) {
 
-    bool ret = false;
     size_t max_dim = max(from, to);
     if (trace) {
         cout << "checking to add " << from << " => " << to << endl;
     }
-    if (rows.size() <= max_dim) {
+    if (num_rows <= max_dim) {
         max_dim = max_dim + 1;
         if (trace) {
-            cout << "resizing rows from " << rows.size() << " to "
+            cout << "resizing rows from " << num_rows << " to "
                  << max_dim << endl;
         }
-        rows.resize(max_dim);
-        if (num_outgoing.size() <= max_dim) {
-            num_outgoing.resize(max_dim);
+        num_rows = max_dim;
+    }
+
+    if (pending_arcs.empty()) {
+        pending_arcs.resize(1);
+    }
+    pending_arcs.back().from.push_back(from);
+    pending_arcs.back().to.push_back(to);
+}
+
+void Table::remap_ids() {
+
+    RunStats::Mark start = stats.mark();
+
+    size_t num_buffers = pending_arcs.size();
+    vector< vector<uint64_t> > buffer_ids(num_buffers);
+
+    /* The distinct IDs of each buffer, in order of first appearance */
+#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+    for (size_t b = 0; b < num_buffers; b++) {
+        IdMap seen;
+        const ArcBuffer &arcs = pending_arcs[b];
+        for (size_t k = 0; k < arcs.from.size(); k++) {
+            if (seen.insert(arcs.from[k], 0)) {
+                buffer_ids[b].push_back(arcs.from[k]);
+            }
+            if (seen.insert(arcs.to[k], 0)) {
+                buffer_ids[b].push_back(arcs.to[k]);
+            }
         }
     }
 
-    ret = insert_into_vector(rows[to], from);
+    IdMap ids;
+    size_t total = 0;
+    for (size_t b = 0; b < num_buffers; b++) {
+        total += buffer_ids[b].size();
+    }
+    ids.reserve(total);
+    vector<uint64_t> &original = node_ids.edit();
+    original.clear();
+    for (size_t b = 0; b < num_buffers; b++) {
+        for (size_t k = 0; k < buffer_ids[b].size(); k++) {
+            if (ids.insert(buffer_ids[b][k], original.size())) {
+                original.push_back(buffer_ids[b][k]);
+            }
+        }
+        vector<uint64_t>().swap(buffer_ids[b]);
+    }
+    vector<uint64_t>(original).swap(original);
+    num_rows = original.size();
+
+    for (size_t b = 0; b < num_buffers; b++) {
+        ArcBuffer &arcs = pending_arcs[b];
+        size_t n = arcs.from.size();
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (size_t k = 0; k < n; k++) {
+            arcs.from[k] = ids.find(arcs.from[k]);
+            arcs.to[k] = ids.find(arcs.to[k]);
+        }
+    }
 
-    if (ret) {
-        num_outgoing[from]++;
-        if (trace) {
-            cout << "added " << from << " => " << to << endl;
+    stats.add_phase("intern", start);
+    cerr << "renumbered " << num_rows << " vertices" << endl;
+}
+
+void Table::build_graph() {
+
+    RunStats::Mark start = stats.mark();
+    size_t num_arcs = 0;
+    vector<size_t> counts(num_rows + 1);
+    vector<ArcBuffer>::iterator cb; // current buffer
+    size_t k;
+
+    /* First pass: stable counting sort of the arcs by source */
+    for (cb = pending_arcs.begin(); cb != pending_arcs.end(); cb++) {
+        for (k = 0; k < cb->from.size(); k++) {
+            counts[cb->from[k] + 1]++;
         }
+        num_arcs += cb->from.size();
+    }
+    for (k = 0; k < num_rows; k++) {
+        counts[k + 1] += counts[k];
+    }
+    vector<size_t> by_from_src(num_arcs);
+    vector<size_t> by_from_dst(num_arcs);
+    for (cb = pending_arcs.begin(); cb != pending_arcs.end(); cb++) {
+        for (k = 0; k < cb->from.size(); k++) {
+            size_t pos = counts[cb->from[k]]++;
+            by_from_src[pos] = cb->from[k];
+            by_from_dst[pos] = cb->to[k];
+        }
+        vector<size_t>().swap(cb->from);
+        vector<size_t>().swap(cb->to);
+    }
+    pending_arcs.clear();
+
+    /*
+     * Second pass: stable counting sort by destination. Since the input
+     * is ordered by source, each row comes out sorted by source.
+     */
+    vector<size_t> &offsets = row_offsets.edit();
+    vector<size_t> &links = in_links.edit();
+    offsets.assign(num_rows + 1, 0);
+    for (k = 0; k < num_arcs; k++) {
+        offsets[by_from_dst[k] + 1]++;
+    }
+    for (k = 0; k < num_rows; k++) {
+        offsets[k + 1] += offsets[k];
     }
+    counts.assign(offsets.begin(), offsets.end() - 1);
+    links.resize(num_arcs);
+    for (k = 0; k < num_arcs; k++) {
+        links[counts[by_from_dst[k]]++] = by_from_src[k];
+    }
+    vector<size_t>().swap(by_from_src);
+    vector<size_t>().swap(by_from_dst);
+
+    /* Drop duplicate arcs, compacting the rows in place */
+    vector<size_t> &outgoing = num_outgoing.edit();
+    outgoing.assign(num_rows, 0);
+    size_t out = 0;
+    size_t row_start = 0;
+    for (size_t i = 0; i < num_rows; i++) {
+        size_t row_end = offsets[i + 1];
+        offsets[i] = out;
+        for (k = row_start; k < row_end; k++) {
+            size_t from = links[k];
+            if (k == row_start || from != links[k - 1]) {
+                links[out++] = from;
+                outgoing[from]++;
+                if (trace) {
+                    cout << "added " << from << " => " << i << endl;
+                }
+            }
+        }
+        row_start = row_end;
+    }
+    offsets[num_rows] = out;
+    links.resize(out);
+    vector<size_t>(links).swap(links);
+    out_offsets.clear();
+    out_links.clear();
+    drop_link_copies();
+    stats.add_phase("build", start);
+}
 
-    return ret;
+/*
+ * Sets gaps to the in-links of rows [first, last), each row coded as the
+ * differences between its sorted in-links, starting from zero.
+ */
+static void link_gaps(const size_t *offsets, const size_t *links,
+                      size_t first, size_t last, vector<uint32_t> &gaps) {
+    gaps.clear();
+    for (size_t i = first; i < last; i++) {
+        size_t prev = 0;
+        for (size_t k = offsets[i]; k < offsets[i + 1]; k++) {
+            gaps.push_back((uint32_t) (links[k] - prev));
+            prev = links[k];
+        }
+    }
+}
+
+/*
+ * Decodes the in-links of rows [first, last), packed from p on, into
+ * links, setting offsets[r] to the start of row first + r in links.
+ * gaps is scratch space.
+ */
+template <class Index>
+static void unpack_rows(const uint8_t *p, const size_t *row_offsets,
+                        size_t first, size_t last, vector<uint32_t> &gaps,
+                        vector<size_t> &offsets, vector<Index> &links) {
+    size_t n = row_offsets[last] - row_offsets[first];
+    gaps.resize(n + 3);
+    get_group_varint(p, gaps.data(), n);
+    offsets.resize(last - first + 1);
+    links.resize(n);
+    size_t k = 0;
+    for (size_t i = first; i < last; i++) {
+        offsets[i - first] = k;
+        Index prev = 0;
+        for (size_t end = k + row_offsets[i + 1] - row_offsets[i]; k < end;
+             k++) {
+            prev += gaps[k];
+            links[k] = prev;
+        }
+    }
+    offsets[last - first] = k;
+}
+
+void Table::pack_links() {
+
+    RunStats::Mark start = stats.mark();
+
+    size_t num_blocks = (num_rows + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    const size_t *offsets = row_offsets.data();
+    const size_t *links = in_links.data();
+
+    /* Size every block, then code them all in place */
+    packed_blocks.assign(num_blocks + 1, 0);
+#pragma omp parallel num_threads(num_threads)
+    {
+        vector<uint32_t> gaps;
+#pragma omp for schedule(dynamic, 16)
+        for (size_t b = 0; b < num_blocks; b++) {
+            size_t last = min((b + 1) * REDUCE_BLOCK, num_rows);
+            link_gaps(offsets, links, b * REDUCE_BLOCK, last, gaps);
+            packed_blocks[b + 1] = group_varint_size(gaps.data(), gaps.size());
+        }
+#pragma omp single
+        {
+            for (size_t b = 0; b < num_blocks; b++) {
+                packed_blocks[b + 1] += packed_blocks[b];
+            }
+            packed_links.resize(packed_blocks[num_blocks]
+                                + GROUP_VARINT_PADDING);
+        }
+#pragma omp for schedule(dynamic, 16)
+        for (size_t b = 0; b < num_blocks; b++) {
+            size_t last = min((b + 1) * REDUCE_BLOCK, num_rows);
+            link_gaps(offsets, links, b * REDUCE_BLOCK, last, gaps);
+            put_group_varint(packed_links.data() + packed_blocks[b],
+                             gaps.data(), gaps.size());
+        }
+    }
+
+    size_t num_arcs = row_offsets.back();
+    cerr << "packed " << num_arcs << " arcs into " << packed_blocks.back()
+         << " bytes, " << (double) packed_blocks.back() / max(num_arcs, 1UL)
+         << " bytes per arc" << endl;
+
+    in_links.clear();
+    narrow_links.clear();
+    stats.add_phase("compress", start);
+}
+
+void Table::narrow_links_in() {
+
+    if (narrow_links.size() != row_offsets.back()) {
+        unpack_links();
+        vector<uint32_t> &links = narrow_links.edit();
+        links.resize(in_links.size());
+#pragma omp parallel for num_threads(num_threads)
+        for (size_t k = 0; k < links.size(); k++) {
+            links[k] = in_links[k];
+        }
+    }
+    in_links.clear();
+}
+
+void Table::unpack_links() {
+
+    if (!in_links.empty()) {
+        return;
+    }
+    if (!narrow_links.empty()) {
+        vector<size_t> &links = in_links.edit();
+        links.resize(narrow_links.size());
+#pragma omp parallel for num_threads(num_threads)
+        for (size_t k = 0; k < links.size(); k++) {
+            links[k] = narrow_links[k];
+        }
+        return;
+    }
+    if (packed_links.empty()) {
+        return;
+    }
+
+    size_t num_blocks = packed_blocks.size() - 1;
+    vector<size_t> &links = in_links.edit();
+    links.resize(row_offsets.back());
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+    for (size_t b = 0; b < num_blocks; b++) {
+        size_t first = b * REDUCE_BLOCK;
+        size_t last = min(first + REDUCE_BLOCK, num_rows);
+        vector<uint32_t> gaps;
+        vector<size_t> offsets;
+        vector<size_t> block_links;
+        unpack_rows(packed_links.data() + packed_blocks[b], row_offsets.data(),
+                    first, last, gaps, offsets, block_links);
+        copy(block_links.begin(), block_links.end(),
+             links.begin() + row_offsets[first]);
+    }
+}
+
+void Table::drop_link_copies() {
+    narrow_links.clear();
+    vector<uint8_t>().swap(packed_links);
+    packed_blocks.clear();
+}
+
+void Table::partition_rows(size_t parts, vector<size_t> &bounds,
+                           size_t rows) {
+
+    size_t num_blocks = (rows + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    size_t total = rows + row_offsets[rows];
+    size_t acc = 0;
+    size_t t = 1;
+
+    bounds.assign(parts + 1, num_blocks);
+    bounds[0] = 0;
+    for (size_t b = 0; b < num_blocks && t < parts; b++) {
+        size_t first = b * REDUCE_BLOCK;
+        size_t last = min(first + REDUCE_BLOCK, rows);
+        /* A block weighs one unit per row plus one per in-link */
+        acc += (last - first) + (row_offsets[last] - row_offsets[first]);
+        while (t < parts && acc * parts >= total * t) {
+            bounds[t++] = b + 1;
+        }
+    }
 }
 
 void Table::pagerank() {
 
-    vector<size_t>::iterator ci; // current incoming
+    changed_sources.clear();
+
+    if (num_rows == 0) {
+        return;
+    }
+
+    if (!shard_dir.empty()) {
+        if (float_ranks) {
+            iterate_shards<float>();
+        } else {
+            iterate_shards<double>();
+        }
+        return;
+    }
+
+    if (row_offsets.size() != num_rows + 1) {
+        build_graph();
+    }
+
+    bool lump = lump_dangling && !trace;
+    if (lump && !dangling_last()) {
+        reorder_vertices(REORDER_DANGLING);
+    }
+
+    bool push = !lump && !compress && !trace
+        && solver == SOLVER_POWER && extrapolation == EXTRAPOLATE_NONE
+        && use_push_kernel(float_ranks ? sizeof(float) : sizeof(double));
+    if (numa && !trace && (push || lump)) {
+        cerr << "--numa does not place "
+             << (push ? "the push kernel" : "--lump-dangling")
+             << ", which is left to the kernel's default placement" << endl;
+    }
+    if (push) {
+        unpack_links();
+        if (float_ranks) {
+            iterate_push<float>();
+        } else {
+            iterate_push<double>();
+        }
+        return;
+    }
+
+    /*
+     * Iterate over the compressed in-links if asked to; otherwise with
+     * 32-bit in-links whenever the vertices can be numbered with them.
+     * Either copy replaces the plain in-links until the graph changes.
+     * The gaps between in-links are coded as 32-bit values, so
+     * compression also needs fewer than 2^32 vertices.
+     */
+    bool narrow = (num_rows <= numeric_limits<uint32_t>::max());
+    if (compress && narrow && !trace && !lump) {
+        if (packed_links.empty() && row_offsets.back() > 0) {
+            unpack_links();
+            pack_links();
+        }
+        if (float_ranks) {
+            iterate<uint32_t, float>(NULL);
+        } else {
+            iterate<uint32_t, double>(NULL);
+        }
+        return;
+    }
+    if (narrow) {
+        narrow_links_in();
+    } else {
+        unpack_links();
+    }
+    if (narrow) {
+        if (lump && float_ranks) {
+            iterate_lumped<uint32_t, float>(narrow_links.data());
+        } else if (lump) {
+            iterate_lumped<uint32_t, double>(narrow_links.data());
+        } else if (float_ranks) {
+            iterate<uint32_t, float>(narrow_links.data());
+        } else {
+            iterate<uint32_t, double>(narrow_links.data());
+        }
+    } else if (lump && float_ranks) {
+        iterate_lumped<size_t, float>(in_links.data());
+    } else if (lump) {
+        iterate_lumped<size_t, double>(in_links.data());
+    } else if (float_ranks) {
+        iterate<size_t, float>(in_links.data());
+    } else {
+        iterate<size_t, double>(in_links.data());
+    }
+}
+
+/*
+ * Moves elements first to last of v to the NUMA node with number node.
+ */
+template <class T>
+static void move_rows(const T *v, size_t first, size_t last, int node) {
+    move_to_node(v + first, (last - first) * sizeof(T), node);
+}
+
+template <class Index, class Rank>
+void Table::iterate(const Index *links) {
+
     double diff = 1;
-    size_t i;
     double sum_pr; // sum of current pagerank vector elements
     double dangling_pr; // sum of current pagerank vector elements for dangling
     			// nodes
-    unsigned long num_iterations = 0;
-    vector<double> old_pr;
-
-    size_t num_rows = rows.size();
-    
-    if (num_rows == 0) {
-        return;
+    double one_Av, one_Iv;
+    num_iterations = 0;
+    RunStats::Mark start = stats.mark();
+    double num_arcs = row_offsets[num_rows];
+    vector<Rank> contrib; // old pagerank of each column over its out-links
+    vector<double> inv_outgoing; // 1 / num_outgoing, or 0 if dangling
+    vector<Rank> next_contrib; // contrib as updated during a sweep
+    bool in_place = (solver != SOLVER_POWER);
+    double relax = (solver == SOLVER_SOR) ? omega : 1.0;
+    double least_diff = numeric_limits<double>::infinity();
+    size_t stalled = 0; // sweeps since least_diff was last lowered
+
+    /*
+     * The iterates before the current one, for extrapolation, in a ring
+     * whose newest entry is history[newest]. The ring holds num_saved
+     * consecutive iterates since the last extrapolation.
+     */
+    size_t depth = 0;
+    if (!in_place && extrapolation == EXTRAPOLATE_QUADRATIC) {
+        depth = 3;
     }
+    size_t period = max(extrapolation_period, depth);
+    vector<vector<double> > history(depth, vector<double>(num_rows));
+    size_t newest = 0;
+    size_t num_saved = 0;
+    size_t num_extrapolations = 0;
+    double weights[3]; // of the three latest iterates, or none if empty
+    bool extrapolate = false;
+
+    const size_t *offsets = row_offsets.data();
+    const size_t *outgoing = num_outgoing.data();
+    const GatherKernel<Index, Rank> &kernel = best_gather_kernel<Index, Rank>();
+    bool packed = (links == NULL);
+
+    /* Tracing output is only meaningful when produced in order */
+    size_t nthreads = trace ? 1 : num_threads;
+    vector<size_t> bounds;
+
+    /*
+     * Partial sums are kept per block of rows and added up in block
+     * order, so the result does not depend on the number of threads.
+     */
+    size_t num_blocks = (num_rows + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    vector<double> block_sum(num_blocks);
+    vector<double> block_dangling(num_blocks);
+    vector<double> block_diff(num_blocks);
+    vector<double> block_dots(depth == 3 ? num_blocks * 5 : 0);
+
+    /*
+     * With replication node 0 gathers from contrib, which then lives on
+     * it, and node k > 0 from replicas[k - 1].
+     */
+    const NumaTopology &topology = NumaTopology::get();
+    bool replicate = numa && numa_replicate && !in_place && !trace
+        && topology.num_nodes() > 1;
+    vector<vector<Rank> > replicas(replicate ? topology.num_nodes() - 1 : 0,
+                                   vector<Rank>(num_rows));
+    vector<NodeStats> node_stats(numa && !trace ? topology.num_nodes() : 0);
     
-    pr.resize(num_rows);
+    pr.assign(num_rows, 0);
+    contrib.resize(num_rows);
+    if (in_place) {
+        next_contrib.resize(num_rows);
+    }
+    inv_outgoing.resize(num_rows);
+    for (size_t k = 0; k < num_rows; k++) {
+        inv_outgoing[k] = outgoing[k] ? 1.0 / outgoing[k] : 0.0;
+    }
 
     pr[0] = 1;
+    sum_pr = 1;
+    dangling_pr = (outgoing[0] == 0) ? 1 : 0;
+
+    /*
+     * The elements of the A x I and 1 x I vectors are all identical;
+     * they are computed for the normalised pagerank vector, whose
+     * elements sum to one.
+     */
+    one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+    one_Iv = (1 - alpha) / num_rows;
 
     if (trace) {
         print_pagerank();
     }
-    
-    while (diff > convergence && num_iterations < max_iterations) {
-
-        sum_pr = 0;
-        dangling_pr = 0;
-        
-        for (size_t k = 0; k < pr.size(); k++) {
-            double cpr = pr[k];
-            sum_pr += cpr;
-            if (num_outgoing[k] == 0) {
-                dangling_pr += cpr;
+
+    stats.start_iterations();
+#pragma omp parallel num_threads(nthreads)
+    {
+        /* The runtime may give us fewer threads than we asked for */
+#pragma omp single
+        partition_rows(omp_get_num_threads(), bounds, num_rows);
+
+        size_t t = omp_get_thread_num();
+        size_t first_row = min(bounds[t] * REDUCE_BLOCK, num_rows);
+        size_t last_row = min(bounds[t + 1] * REDUCE_BLOCK, num_rows);
+        vector<double> h(REDUCE_BLOCK); // the H multiplication for a block
+        vector<size_t> block_offsets; // a block of packed rows, decoded
+        vector<Index> block_links;
+        vector<uint32_t> block_gaps;
+        size_t num_team = omp_get_num_threads();
+        size_t node = topology.thread_node(t, num_team);
+
+        if (!node_stats.empty()) {
+            /*
+             * The vectors and the CSR arrays were filled by one thread,
+             * so the rows of each thread are moved to its node rather
+             * than left to the first touch.
+             */
+            int id = topology.node_id(node);
+            pin_thread(topology.thread_cpu(t, num_team));
+            move_rows(pr.data(), first_row, last_row, id);
+            move_rows(contrib.data(), first_row, last_row,
+                      replicate ? topology.node_id(0) : id);
+            for (size_t r = 0; r < replicas.size(); r++) {
+                move_rows(replicas[r].data(), first_row, last_row,
+                          topology.node_id(r + 1));
+            }
+            move_rows(inv_outgoing.data(), first_row, last_row, id);
+            move_rows(next_contrib.data(), first_row,
+                      in_place ? last_row : first_row, id);
+            for (size_t d = 0; d < depth; d++) {
+                move_rows(history[d].data(), first_row, last_row, id);
+            }
+            move_rows(offsets, first_row, last_row + 1, id);
+            move_rows(outgoing, first_row, last_row, id);
+            if (packed) {
+                move_rows(packed_links.data(), packed_blocks[bounds[t]],
+                          packed_blocks[bounds[t + 1]], id);
+            } else {
+                move_rows(links, offsets[first_row], offsets[last_row], id);
             }
-        }
 
-        if (num_iterations == 0) {
-            old_pr = pr;
-        } else {
-            /* Normalize so that we start with sum equal to one */
-            for (i = 0; i < pr.size(); i++) {
-                old_pr[i] = pr[i] / sum_pr;
+            /*
+             * Every row is read and written once, each in-link and the
+             * contribution it points to read once, and each copy of the
+             * contribution of a row written once.
+             */
+            size_t copies = replicas.size() + 1;
+            size_t row_bytes = 2 * sizeof(size_t) + 3 * sizeof(double)
+                + copies * sizeof(Rank);
+            size_t link_bytes = packed
+                ? packed_blocks[bounds[t + 1]] - packed_blocks[bounds[t]]
+                : (offsets[last_row] - offsets[first_row]) * sizeof(Index);
+            size_t num_links = offsets[last_row] - offsets[first_row];
+#pragma omp critical
+            {
+                NodeStats &ns = node_stats[node];
+                ns.node = topology.node_id(node);
+                ns.threads++;
+                ns.rows += last_row - first_row;
+                ns.in_links += num_links;
+                ns.bytes_per_iteration += (last_row - first_row) * row_bytes
+                    + link_bytes + num_links * sizeof(Rank);
             }
+#pragma omp barrier
         }
+        const Rank *gathered = (node == 0 || replicas.empty())
+            ? contrib.data() : replicas[node - 1].data();
+
+        while (diff > convergence && num_iterations < max_iterations) {
 
-        /*
-         * After normalisation the elements of the pagerank vector sum
-         * to one
-         */
-        sum_pr = 1;
-        
-        /* An element of the A x I vector; all elements are identical */
-        double one_Av = alpha * dangling_pr / num_rows;
-
-        /* An element of the 1 x I vector; all elements are identical */
-        double one_Iv = (1 - alpha) * sum_pr / num_rows;
-
-        /* The difference to be checked for convergence */
-        diff = 0;
-        for (i = 0; i < num_rows; i++) {
-            /* The corresponding element of the H multiplication */
-            double h = 0.0;
-            for (ci = rows[i].begin(); ci != rows[i].end(); ci++) {
-                /* The current element of the H vector */
-                double h_v = (num_outgoing[*ci])
-                    ? 1.0 / num_outgoing[*ci]
-                    : 0.0;
+            /*
+             * Normalize so that we start with sum equal to one, and
+             * spread the pagerank of each column over its out-links
+             */
+            for (size_t i = first_row; i < last_row; i++) {
+                pr[i] /= sum_pr;
+            }
+            if (depth > 0) {
+                if (num_saved >= period) {
+                    /*
+                     * Replace the current iterate x with one extrapolated
+                     * from it and the previous ones, x1, x2 and x3; x
+                     * takes the place of x1 once that has been read.
+                     */
+                    double *x1 = history[newest].data();
+                    const double *x2 = history[(newest + depth - 1)
+                                               % depth].data();
+                    const double *x3 = history[(newest + depth - 2)
+                                               % depth].data();
+                    /*
+                     * With y1, y2, y the differences of x2, x1, x from
+                     * x3, find the g1, g2 for which g1 y1 + g2 y2 + y is
+                     * least, from the normal equations of [y1 y2]. Dot
+                     * products are summed per block, to be added up in
+                     * block order.
+                     */
+                    for (size_t b = bounds[t]; b < bounds[t + 1]; b++) {
+                        size_t first = b * REDUCE_BLOCK;
+                        size_t last = min(first + REDUCE_BLOCK, num_rows);
+                        double *dots = block_dots.data() + 5 * b;
+                        fill(dots, dots + 5, 0.0);
+                        for (size_t i = first; i < last; i++) {
+                            double y1 = x2[i] - x3[i];
+                            double y2 = x1[i] - x3[i];
+                            double y = pr[i] - x3[i];
+                            dots[0] += y1 * y1;
+                            dots[1] += y1 * y2;
+                            dots[2] += y2 * y2;
+                            dots[3] += y1 * y;
+                            dots[4] += y2 * y;
+                        }
+                    }
+#pragma omp barrier
+#pragma omp single
+                    {
+                        double d[5] = { 0, 0, 0, 0, 0 };
+                        for (size_t b = 0; b < num_blocks; b++) {
+                            for (size_t j = 0; j < 5; j++) {
+                                d[j] += block_dots[5 * b + j];
+                            }
+                        }
+                        double det = d[0] * d[2] - d[1] * d[1];
+                        extrapolate = det > 1e-12 * d[0] * d[2];
+                        if (extrapolate) {
+                            double g1 = (d[4] * d[1] - d[3] * d[2]) / det;
+                            double g2 = (d[3] * d[1] - d[4] * d[0]) / det;
+                            weights[0] = 1; // of x
+                            weights[1] = g2 + 1; // of x1
+                            weights[2] = g1 + g2 + 1; // of x2
+                        }
+                    }
+                    for (size_t b = bounds[t]; b < bounds[t + 1]; b++) {
+                        size_t first = b * REDUCE_BLOCK;
+                        size_t last = min(first + REDUCE_BLOCK, num_rows);
+                        double bsum = 0;
+                        double bdangling = 0;
+                        for (size_t i = first; i < last; i++) {
+                            double x = pr[i];
+                            double x1i = x1[i];
+                            x1[i] = x;
+                            if (extrapolate) {
+                                x = weights[0] * x + weights[1] * x1i
+                                    + weights[2] * x2[i];
+                            }
+                            pr[i] = x;
+                            bsum += x;
+                            if (outgoing[i] == 0) {
+                                bdangling += x;
+                            }
+                        }
+                        block_sum[b] = bsum;
+                        block_dangling[b] = bdangling;
+                    }
+#pragma omp barrier
+#pragma omp single
+                    {
+                        sum_pr = 0;
+                        dangling_pr = 0;
+                        for (size_t b = 0; b < num_blocks; b++) {
+                            sum_pr += block_sum[b];
+                            dangling_pr += block_dangling[b];
+                        }
+                        one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+                        if (extrapolate) {
+                            num_extrapolations++;
+                        }
+                        num_saved = 0;
+                    }
+                    for (size_t i = first_row; i < last_row; i++) {
+                        pr[i] /= sum_pr;
+                    }
+                }
+                /* The current iterate joins the ring */
+                vector<double> &saved = history[(newest + 1) % depth];
+                for (size_t i = first_row; i < last_row; i++) {
+                    saved[i] = pr[i];
+                }
+            }
+            for (size_t i = first_row; i < last_row; i++) {
+                contrib[i] = pr[i] * inv_outgoing[i];
+            }
+            for (vector<Rank> &replica : replicas) {
+                copy(contrib.begin() + first_row, contrib.begin() + last_row,
+                     replica.begin() + first_row);
+            }
+            if (in_place) {
+                for (size_t i = first_row; i < last_row; i++) {
+                    next_contrib[i] = contrib[i];
+                }
+            }
+
+#pragma omp barrier
+
+            for (size_t b = bounds[t]; b < bounds[t + 1]; b++) {
+                size_t first = b * REDUCE_BLOCK;
+                size_t last = min(first + REDUCE_BLOCK, num_rows);
+                double bsum = 0;
+                double bdangling = 0;
+                /* The difference to be checked for convergence */
+                double bdiff = 0;
+                /* Row i has in-links blinks[boffsets[i - base]..] */
+                const size_t *boffsets = offsets;
+                const Index *blinks = links;
+                size_t base = 0;
+                if (packed) {
+                    unpack_rows(packed_links.data() + packed_blocks[b],
+                                offsets, first, last, block_gaps,
+                                block_offsets, block_links);
+                    boffsets = block_offsets.data();
+                    blinks = block_links.data();
+                    base = first;
+                }
                 if (num_iterations == 0 && trace) {
-                    cout << "h[" << i << "," << *ci << "]=" << h_v << endl;
+                    for (size_t i = first; i < last; i++) {
+                        for (size_t k = offsets[i]; k < offsets[i + 1]; k++) {
+                            cout << "h[" << i << "," << links[k] << "]="
+                                 << inv_outgoing[links[k]] << endl;
+                        }
+                    }
+                }
+                if (in_place) {
+                    /*
+                     * Gauss-Seidel: use the values of this sweep for the
+                     * columns of this thread that are already updated, and
+                     * those of the previous sweep for everything else.
+                     * With SOR the update is over-relaxed by omega.
+                     */
+                    size_t own = last_row - first_row;
+                    for (size_t i = first; i < last; i++) {
+                        double hi = 0.0;
+                        for (size_t k = boffsets[i - base];
+                             k < boffsets[i - base + 1]; k++) {
+                            size_t j = blinks[k];
+                            hi += (j - first_row < own)
+                                ? next_contrib[j]
+                                : contrib[j];
+                        }
+                        double gs = alpha * hi + one_Av + one_Iv;
+                        double cpr = pr[i] + relax * (gs - pr[i]);
+                        bdiff += fabs(cpr - pr[i]);
+                        pr[i] = cpr;
+                        next_contrib[i] = cpr * inv_outgoing[i];
+                        bsum += cpr;
+                        if (outgoing[i] == 0) {
+                            bdangling += cpr;
+                        }
+                    }
+                } else {
+                    kernel.gather_rows(gathered, boffsets, blinks,
+                                       first - base, last - base, h.data());
+                    for (size_t i = first; i < last; i++) {
+                        double cpr = alpha * h[i - first] + one_Av + one_Iv;
+                        bdiff += fabs(cpr - pr[i]);
+                        pr[i] = cpr;
+                        bsum += cpr;
+                        if (outgoing[i] == 0) {
+                            bdangling += cpr;
+                        }
+                    }
+                }
+                block_sum[b] = bsum;
+                block_dangling[b] = bdangling;
+                block_diff[b] = bdiff;
+            }
+
+#pragma omp barrier
+#pragma omp single
+            {
+                diff = 0;
+                sum_pr = 0;
+                dangling_pr = 0;
+                for (size_t b = 0; b < num_blocks; b++) {
+                    diff += block_diff[b];
+                    sum_pr += block_sum[b];
+                    dangling_pr += block_dangling[b];
+                }
+                one_Av = alpha * (dangling_pr / sum_pr) / num_rows;
+                num_iterations++;
+                if (!isfinite(diff)) {
+                    error("The iterations diverged, the difference is",
+                          to_string(diff).c_str());
+                }
+                if (diff < least_diff) {
+                    least_diff = diff;
+                    stalled = 0;
+                } else if (relax > 1 && ++stalled >= DIVERGENCE_SWEEPS) {
+                    error("The iterations diverge; SOR is only sure to "
+                          "converge with omega up to 1");
+                }
+                if (depth > 0) {
+                    newest = (newest + 1) % depth;
+                    num_saved++;
+                }
+                stats.add_iteration(diff, dangling_pr / sum_pr, num_arcs);
+                if (verbose) {
+                    cerr << "iteration " << num_iterations << " diff = "
+                         << diff << endl;
+                }
+                if (trace) {
+                    cout << num_iterations << ": ";
+                    print_pagerank();
                 }
-                h += h_v * old_pr[*ci];
             }
-            h *= alpha;
-            pr[i] = h + one_Av + one_Iv;
-            diff += fabs(pr[i] - old_pr[i]);
         }
-        num_iterations++;
-        if (trace) {
-            cout << num_iterations << ": ";
-            print_pagerank();
+
+        if (!node_stats.empty()) {
+            unpin_thread();
         }
     }
-    
+
+    /* Leave the final vector normalised, as the iterations assume */
+    for (size_t i = 0; i < num_rows; i++) {
+        pr[i] /= sum_pr;
+    }
+
+    stats.add_phase("iterate", start);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now()
+                                              - start.time).count();
+    cerr << solver_name(solver) << " solver finished after "
+         << num_iterations << " iterations, diff = " << diff << ", "
+         << elapsed * 1000 / max(num_iterations, 1UL)
+         << " ms per iteration";
+    if (depth > 0) {
+        cerr << ", " << num_extrapolations << " "
+             << extrapolation_name(extrapolation) << " extrapolations";
+    }
+    cerr << endl;
+
+    /* Nodes without threads of this team are left out */
+    size_t num_nodes = 0;
+    for (NodeStats &ns : node_stats) {
+        if (ns.threads == 0) {
+            continue;
+        }
+        ns.bytes_per_second = elapsed > 0
+            ? ns.bytes_per_iteration * num_iterations / elapsed : 0;
+        cerr << "node " << ns.node << ": " << ns.threads << " threads, "
+             << ns.rows << " rows, " << ns.in_links << " in-links, about "
+             << ns.bytes_per_second / 1e9 << " GB/s"
+             << (replicate ? ", with replicated contributions" : "")
+             << endl;
+        node_stats[num_nodes++] = ns;
+    }
+    node_stats.resize(num_nodes);
+    stats.set_nodes(node_stats);
 }
 
 const void Table::print_params(ostream& out) {
     out << "alpha = " << alpha << " convergence = " << convergence
         << " max_iterations = " << max_iterations
         << " numeric = " << numeric
+        << " remap = " << remap
+        << " threads = " << num_threads
+        << " solver = " << solver_name(solver)
+        << " omega = " << omega
+        << " extrapolation = " << extrapolation_name(extrapolation)
+        << " lump_dangling = " << lump_dangling
+        << " kernel = " << kernel_name(iteration_kernel)
+        << " numa = " << numa
+        << " numa_replicate = " << numa_replicate
+        << " ranks = " << (float_ranks ? "float" : "double")
+        << " gather = " << best_gather_kernel<uint32_t, double>().name
         << " delimiter = '" << delim << "'" << endl;
 }
 
 const void Table::print_table() {
-    vector< vector<size_t> >::iterator cr;
-    vector<size_t>::iterator cc; // current column
+    size_t cc; // current column
 
-    size_t i = 0;
-    for (cr = rows.begin(); cr != rows.end(); cr++) {
+    unpack_links();
+
+    for (size_t i = 0; i < num_rows; i++) {
         cout << i << ":[ ";
-        for (cc = cr->begin(); cc != cr->end(); cc++) {
-            if (numeric) {
-                cout << *cc << " ";
+        for (cc = row_offsets[i]; cc != row_offsets[i + 1]; cc++) {
+            if (numeric && !remap) {
+                cout << in_links[cc] << " ";
             } else {
-                cout << idx_to_nodes[*cc] << " ";
+                cout << get_node_name(in_links[cc]) << " ";
             }
         }
         cout << "]" << endl;
-        i++;
     }
 }
 
 const void Table::print_outgoing() {
-    vector<size_t>::iterator cn;
+    const size_t *cn;
 
     cout << "[ ";
     for (cn = num_outgoing.begin(); cn != num_outgoing.end(); cn++) {
@@ -428,21 +1411,3 @@ const void Table::print_pagerank() {
     cout << "] "<< sum << endl;
 }
 
-const void Table::print_pagerank_v() {
-
-    size_t i;
-    size_t num_rows = pr.size();
-    double sum = 0;
-    
-    cout.precision(numeric_limits<double>::digits10);
-
-    for (i = 0; i < num_rows; i++) {
-        if (!numeric) {
-            cout << idx_to_nodes[i] << " = " << pr[i] << endl;
-        } else {
-            cout << i << " = " << pr[i] << endl;
-        }
-        sum += pr[i];
-    }
-    cerr << "s = " << sum << " " << endl;
-}
@@ -37,14 +37,173 @@
 #include <map>
 #include <string>
 #include <list>
+#include <memory>
+#include <functional>
+
+#include "mapped_array.h"
+#include "string_pool.h"
+#include "id_map.h"
+#include "stats.h"
 
 using namespace std;
 
+class Transport;
+
 const double DEFAULT_ALPHA = 0.85;
 const double DEFAULT_CONVERGENCE = 0.00001;
 const unsigned long DEFAULT_MAX_ITERATIONS = 10000;
 const bool DEFAULT_NUMERIC = false;
+const bool DEFAULT_REMAP = false;
 const string DEFAULT_DELIM = " => ";
+const size_t DEFAULT_THREADS = 1;
+const bool DEFAULT_FLOAT_RANKS = false;
+const bool DEFAULT_COMPRESS = false;
+const double DEFAULT_EPSILON = 0.000001; // residual tolerance of local_pagerank
+const size_t DEFAULT_SHARD_ROWS = 1 << 20; // rows per out-of-core shard
+
+/*
+ * The methods for solving the pagerank equations:
+ * - SOLVER_POWER: the power method (Jacobi iteration), computing each
+ *   iteration from a copy of the previous one
+ * - SOLVER_GAUSS_SEIDEL: Gauss-Seidel iteration, updating the pagerank
+ *   vector in place and using the values already updated in the sweep
+ * - SOLVER_SOR: successive over-relaxation; Gauss-Seidel iteration with
+ *   each update scaled by a relaxation factor (omega)
+ * When running on several threads the in-place methods are applied to
+ * each thread's block of rows, with the values of the other blocks
+ * taken from the previous sweep.
+ */
+enum Solver {
+    SOLVER_POWER,
+    SOLVER_GAUSS_SEIDEL,
+    SOLVER_SOR
+};
+const Solver DEFAULT_SOLVER = SOLVER_POWER;
+const double DEFAULT_OMEGA = 1.0;
+/* Sweeps of SOR with omega > 1 without a new smallest difference after
+   which the iterations are taken to diverge */
+const size_t DIVERGENCE_SWEEPS = 20;
+
+/*
+ * Returns the name of a solver, as accepted by parse_solver().
+ */
+const char *solver_name(Solver s);
+
+/*
+ * Sets s to the solver called name ("power", "gs" or "sor"). Returns
+ * false if there is no such solver.
+ */
+bool parse_solver(const char *name, Solver &s);
+
+/*
+ * The extrapolations that can accelerate the power method (Kamvar,
+ * Haveliwala, Manning and Golub), applied every few iterations to the
+ * last iterates:
+ * - EXTRAPOLATE_QUADRATIC: quadratic extrapolation, which takes the
+ *   last four iterates as spanning the first three eigenvectors and
+ *   removes the second and third by least squares
+ * Aitken's delta squared process, from the same paper, is left out: on
+ * every graph tried the difference grew after it, even when it was only
+ * applied once successive differences had settled to the same ratio.
+ */
+enum Extrapolation {
+    EXTRAPOLATE_NONE,
+    EXTRAPOLATE_QUADRATIC
+};
+const Extrapolation DEFAULT_EXTRAPOLATION = EXTRAPOLATE_NONE;
+const size_t DEFAULT_EXTRAPOLATION_PERIOD = 10;
+
+/*
+ * Returns the name of an extrapolation, as accepted by
+ * parse_extrapolation().
+ */
+const char *extrapolation_name(Extrapolation e);
+
+/*
+ * Sets e to the extrapolation called name ("none" or "quadratic").
+ * Returns false if there is no such extrapolation.
+ */
+bool parse_extrapolation(const char *name, Extrapolation &e);
+
+/*
+ * How the power method reads the hyperlink matrix:
+ * - KERNEL_PULL: each row gathers the contributions of its in-links
+ * - KERNEL_PUSH: propagation blocking; the contributions are first
+ *   pushed along the out-links into bins of rows that fit in cache,
+ *   then added up bin by bin
+ * - KERNEL_AUTO: push when the contributions do not fit in the
+ *   last-level cache, pull otherwise or with NUMA placement
+ */
+enum IterationKernel {
+    KERNEL_AUTO,
+    KERNEL_PULL,
+    KERNEL_PUSH
+};
+const IterationKernel DEFAULT_KERNEL = KERNEL_AUTO;
+
+/*
+ * Returns the name of an iteration kernel, as accepted by parse_kernel().
+ */
+const char *kernel_name(IterationKernel k);
+
+/*
+ * Sets k to the iteration kernel called name ("auto", "pull" or
+ * "push"). Returns false if there is no such kernel.
+ */
+bool parse_kernel(const char *name, IterationKernel &k);
+
+/*
+ * The vertex orders reorder_vertices() can renumber a graph to:
+ * - REORDER_NONE: keep the numbering of the input
+ * - REORDER_DEGREE: by decreasing number of in- plus out-links
+ * - REORDER_RCM: reverse Cuthill-McKee, breadth first from low degree
+ *   vertices, which keeps the neighbours of a vertex close to it
+ * - REORDER_GORDER: Gorder, which greedily places next the vertex sharing
+ *   the most links and in-neighbours with the last few placed
+ * - REORDER_DANGLING: the vertices with out-links first and the dangling
+ *   ones last, each in their current order, as lumping them needs
+ */
+enum Reorder {
+    REORDER_NONE,
+    REORDER_DEGREE,
+    REORDER_RCM,
+    REORDER_GORDER,
+    REORDER_DANGLING
+};
+
+/*
+ * Returns the name of a vertex order, as accepted by parse_reorder().
+ */
+const char *reorder_name(Reorder r);
+
+/*
+ * Sets r to the vertex order called name ("none", "degree", "rcm",
+ * "gorder" or "dangling"). Returns false if there is no such order.
+ */
+bool parse_reorder(const char *name, Reorder &r);
+
+/*
+ * Orders ranked vertices by decreasing pagerank, then by vertex number.
+ */
+inline bool higher_rank(const pair<size_t, double> &a,
+                        const pair<size_t, double> &b) {
+    return a.second > b.second || (a.second == b.second && a.first < b.first);
+}
+
+/*
+ * Rows are processed in blocks of this size; partial sums are kept per
+ * block so that reductions do not depend on the number of threads.
+ */
+const size_t REDUCE_BLOCK = 4096;
+
+/*
+ * A batch of arcs read from the input but not yet built into the
+ * hyperlink matrix.
+ */
+struct ArcBuffer {
+    vector<size_t> from;
+    vector<size_t> to;
+};
 
 /*
  * A PageRank calculator. It is responsible for reading data, performing
@@ -65,18 +224,47 @@ private:
     unsigned long max_iterations;
     string delim;
     bool numeric; // input graph has numeric, zero-based indexed vertices
-    vector<size_t> num_outgoing; // number of outgoing links per column
-    vector< vector<size_t> > rows; // the rowns of the hyperlink matrix
-    map<string, size_t> nodes_to_idx; // mapping from string node IDs to numeric
-    map<size_t, string> idx_to_nodes; // mapping from numeric node IDs to string
+    bool remap; // numeric vertices are arbitrary IDs, to be renumbered
+    size_t num_threads; // threads used for the pagerank calculation
+    Solver solver; // the method used to solve the pagerank equations
+    double omega; // the relaxation factor of SOLVER_SOR
+    Extrapolation extrapolation; // how the power method is accelerated
+    size_t extrapolation_period; // iterations between extrapolations
+    bool lump_dangling; // iterate only over the vertices with out-links
+    IterationKernel iteration_kernel; // pull or push for the power method
+    bool numa; // pin the threads and place their rows on their nodes
+    bool numa_replicate; // keep a copy of the contributions per node
+    bool verbose; // log every iteration to cerr
+    bool float_ranks; // iterate with single precision ranks
+    bool compress; // iterate over compressed in-links
+    size_t num_rows; // number of rows (vertices) of the hyperlink matrix
+    MappedArray<size_t> num_outgoing; // number of outgoing links per column
+    MappedArray<size_t> row_offsets; // row i: in_links[row_offsets[i]..[i+1])
+    MappedArray<size_t> in_links; // the rows of the hyperlink matrix, as CSR
+    vector<ArcBuffer> pending_arcs; // arcs not yet built into the CSR
+    StringPool node_names; // string node IDs, indexed by numeric node ID
+    MappedArray<uint64_t> node_ids; // original IDs of renumbered nodes
+    shared_ptr<FileMapping> snapshot; // the snapshot the graph refers to
+    MappedArray<size_t> out_offsets; // row j: out_links[out_offsets[j]..[j+1])
+    MappedArray<size_t> out_links; // the transposed matrix, built on demand
+    map<size_t, vector<size_t> > changed_sources; // out-links before changes
+    IdMap id_index; // node_ids to node numbers, built on demand
+    MappedArray<uint32_t> narrow_links; // in_links as 32-bit indices
+    vector<uint8_t> packed_links; // in_links compressed, on demand
+    vector<size_t> packed_blocks; // block b: packed_links[packed_blocks[b]..]
+    string shard_dir; // the out-of-core shards, if the graph is sharded
+    size_t shard_rows; // rows per shard
+    vector<size_t> shard_arcs; // in-links of each shard
     vector<double> pr; // the pagerank table
+    unsigned long num_iterations; // iterations of the last calculation
+    RunStats stats; // timings and memory use of each phase
+    size_t num_personalized; // number of personalized pagerank vectors
+    vector<double> ppr; // the personalized pageranks, vertex major
 
     /*
      * Trims leading and trailing \t and " " characters from str.
      */
     void trim(string &str);
-    template <class Vector, class T> bool insert_into_vector(Vector& v,
-                                                             const T& t);
 
     /*
      * Clears all internal data structures so that the table can be used
@@ -94,9 +282,257 @@ private:
     size_t insert_mapping(const string &key);
 
     /*
-     * Adds an arc to the hyperlink matrix between from and to.
+     * Parses a line of the graph file into the indices of the from and
+     * to vertices, mapping string vertex names to indices. Numeric IDs
+     * that are to be renumbered are returned as they are. Returns false
+     * if the line has no delimiter.
+     */
+    bool parse_line(const string &line, size_t &from_idx, size_t &to_idx);
+
+    /*
+     * Reads the graph in filename by mapping it into memory and parsing
+     * newline-aligned chunks of it on num_threads threads. Each thread
+     * fills its own ArcBuffer; the buffers are handed to build_graph()
+     * as they are. Returns false, without reading anything, if the file
+     * is not a regular file that can be mapped; the caller should then
+     * fall back to reading it as a stream.
+     */
+    bool read_mapped(const string &filename);
+
+    /*
+     * Reports on cerr the number of lines read so far, and the number of
+     * vertices seen.
+     */
+    void report_progress(size_t linenum);
+
+    /*
+     * Adds an arc to the hyperlink matrix between from and to. The arc is
+     * only queued; it becomes part of the matrix when build_graph() is
+     * called.
+     */
+    void add_arc(size_t from, size_t to);
+
+    /*
+     * Renumbers the vertices of all queued arcs, which are arbitrary
+     * 64-bit IDs, to 0..n-1 in order of first appearance, keeping the
+     * original IDs in node_ids. The distinct IDs of each arc buffer are
+     * collected in parallel and then merged in buffer order; the arcs are
+     * then rewritten in parallel with lookups in the merged IdMap.
+     */
+    void remap_ids();
+
+    /*
+     * Splits the first rows rows into parts contiguous ranges for the
+     * worker threads.
+     * The ranges are balanced by their number of rows plus in-links, so
+     * that rows of highly linked vertices do not end up on a single thread.
+     * On return bounds has parts + 1 entries, in units of REDUCE_BLOCK
+     * rows; part t spans blocks [bounds[t], bounds[t + 1]).
+     */
+    void partition_rows(size_t parts, vector<size_t> &bounds, size_t rows);
+
+    /*
+     * Compresses in_links into packed_links and releases them. Each row
+     * is coded as the gaps between its sorted in-links, with group
+     * varint coding; every REDUCE_BLOCK rows start at a recorded offset,
+     * so that blocks can be decoded independently.
+     */
+    void pack_links();
+
+    /*
+     * Stores in_links as narrow_links, unless that has been done
+     * already, and releases them. Needs fewer than 2^32 vertices.
+     */
+    void narrow_links_in();
+
+    /*
+     * Restores in_links from narrow_links or packed_links, if they have
+     * been released. Called by everything that reads in_links other
+     * than the iterations.
+     */
+    void unpack_links();
+
+    /*
+     * Drops the narrowed and compressed copies of in_links, when the
+     * hyperlink matrix has changed. in_links must be present.
+     */
+    void drop_link_copies();
+
+    /*
+     * Runs the pagerank iterations on the in-links in links, which are
+     * in_links narrowed to Index if it is not size_t, or NULL to decode
+     * packed_links block by block as they are used. The contributions
+     * of the columns are kept as Rank; sums are accumulated in double
+     * and the pagerank vector itself is always double.
+     */
+    template <class Index, class Rank>
+    void iterate(const Index *links);
+
+    /*
+     * Runs the power method over the shards in shard_dir, reading them
+     * one after the other in every iteration while only the vectors
+     * over the vertices are kept in memory. The next shard is read on
+     * another thread while the current one is used. The blocks of rows
+     * and their reductions are those of iterate(), so the results are
+     * the same as those of pagerank() with the graph in memory.
+     */
+    template <class Rank>
+    void iterate_shards();
+
+    /*
+     * Returns true if no vertex with out-links comes after a dangling
+     * one, so that the dangling vertices can be lumped.
+     */
+    bool dangling_last();
+
+    /*
+     * Runs the power method with the dangling vertices, which must come
+     * last, lumped into a single state (Ipsen and Selee). Their in-links
+     * only come from the rows before them, so only those rows are
+     * iterated, together with the pagerank of all dangling vertices,
+     * which is what leaks into them from the other rows plus their equal
+     * shares of the teleport and dangling pagerank. The rows of the
+     * dangling vertices are filled in with one gather at the end, from
+     * the last iterate, so the result is that of iterate(). The
+     * difference checked for convergence counts the dangling vertices
+     * as one.
+     */
+    template <class Index, class Rank>
+    void iterate_lumped(const Index *links);
+
+    /*
+     * Returns true if pagerank() should use iterate_push(), with the
+     * contributions of the columns kept in rank_size bytes each.
+     */
+    bool use_push_kernel(size_t rank_size);
+
+    /*
+     * Runs the power method as iterate() does, but with propagation
+     * blocking (Beamer, Asanovic and Patterson): the rows are split into
+     * bins of PUSH_BIN_BLOCKS blocks, whose sums fit in cache, and each
+     * thread pushes the contribution of each of its columns into its own
+     * part of the bin of every out-link, before the bins are added up
+     * one at a time. Reads of the contributions are then sequential
+     * rather than random, at the cost of writing and reading them once
+     * per in-link. The destination of every pushed contribution is
+     * worked out once, before the iterations. The parts of a bin are
+     * added up in thread order, which is column order, so every row
+     * is summed in the same order as by the scalar gather.
+     */
+    template <class Rank>
+    void iterate_push();
+
+    /*
+     * Returns the path of shard s in shard_dir.
+     */
+    string shard_name(size_t s);
+
+    /*
+     * Reads shard s into buf, setting bytes to its size. Returns false
+     * if it cannot be read. Does not use any other member, so it can be
+     * called on another thread.
+     */
+    bool read_shard(size_t s, vector<uint64_t> &buf, size_t &bytes);
+
+    /*
+     * Checks that the bytes read into buf are shard s and sets offsets
+     * and links to its rows in compressed sparse row form, numbered
+     * from the shard's first row.
+     */
+    void parse_shard(size_t s, const vector<uint64_t> &buf, size_t bytes,
+                     vector<size_t> &offsets, const uint32_t *&links);
+
+    /*
+     * Does a power method step for the rows [first, first + rows), whose
+     * in-links are offsets and links numbered from first, which must
+     * start a block of REDUCE_BLOCK rows; links index contrib. The new
+     * pagerank of row i goes to ranks[i - first] and the sums of each
+     * block to the block_ arrays, at the block's index in the whole
+     * matrix.
+     */
+    template <class Rank>
+    void sweep_rows(const Rank *contrib, const size_t *offsets,
+                    const uint32_t *links, size_t first, size_t rows,
+                    double *ranks, double one_Av, double one_Iv,
+                    double *block_sum, double *block_dangling,
+                    double *block_diff);
+
+    /*
+     * Runs the power method on this worker's part of the shards in
+     * shard_dir, exchanging the contributions of the vertices at the
+     * boundary and the sums of the blocks of rows with the other
+     * workers over transport in every iteration. The vectors are kept
+     * for the worker's own rows and the boundary vertices its in-links
+     * refer to, with the in-links renumbered to match.
+     */
+    template <class Rank>
+    void iterate_partition(Transport &transport);
+
+    /*
+     * Builds out_offsets and out_links, the out-links of every vertex in
+     * compressed sparse row form, by transposing the hyperlink matrix.
+     * Each row is sorted by destination.
      */
-    bool add_arc(size_t from, size_t to);
+    void build_out_links();
+
+    /*
+     * Returns the number of in-links plus out-links of vertex v.
+     */
+    size_t vertex_degree(size_t v);
+
+    /*
+     * Set order to the vertices in the order of reorder_vertices(), as
+     * order[new number] = old number. The out-links must be built for
+     * the orders that follow links.
+     */
+    void order_by_degree(vector<size_t> &order);
+    void order_by_rcm(vector<size_t> &order);
+    void order_by_gorder(vector<size_t> &order);
+    void order_dangling_last(vector<size_t> &order);
+
+    /*
+     * Returns the time in seconds of one single-threaded gather over all
+     * rows, for comparing vertex orders.
+     */
+    double time_gather();
+
+    /*
+     * Adds the arcs in added to the hyperlink matrix and removes those
+     * in removed, which must not overlap, with one pass over each of
+     * the in-links and the out-links, and updates the outgoing link
+     * counts. The matrix grows to at least rows rows. The first time a
+     * vertex's out-links change after a pagerank calculation, the old
+     * ones are saved in changed_sources for update_pagerank().
+     */
+    void change_arcs(vector<pair<size_t, size_t> > added,
+                     vector<pair<size_t, size_t> > removed, size_t rows);
+
+    /*
+     * Returns the number of the vertex with the given name, interpreted
+     * as in read_file(). If the vertex does not exist, it is added to
+     * the vertex names if create is set; otherwise NOT_FOUND is returned.
+     */
+    size_t vertex_index(const string &name, bool create);
+
+    /*
+     * Appends the name of vertex i to out, as the print functions
+     * output it: its name, its original ID or its number.
+     */
+    void append_node_name(string &out, size_t i);
+
+    /*
+     * Appends pagerank r to out with 15 significant digits.
+     */
+    static void append_rank(string &out, double r);
+
+    /*
+     * Writes n lines to cout, line i being appended to a buffer by
+     * format(i, buffer). Chunks of lines are formatted in parallel on
+     * num_threads threads, and every chunk is written with a single
+     * write, so that output is not held back by formatting.
+     */
+    void write_lines(size_t n,
+                     const function<void(size_t, string &)> &format);
     
 public:
     Table(double a = DEFAULT_ALPHA, double c = DEFAULT_CONVERGENCE,
@@ -126,18 +562,218 @@ public:
      */
     void set_num_rows(size_t num_rows);
 
+    /*
+     * Returns the number of arcs of the hyperlink matrix, once built.
+     */
+    const size_t get_num_arcs();
+
+    /*
+     * Returns the number of iterations of the last pagerank calculation.
+     */
+    const unsigned long get_num_iterations();
+
+    /*
+     * Returns the time and memory taken by each phase so far, and the
+     * iterations of the last pagerank calculation.
+     */
+    const RunStats &get_stats();
+
+    /*
+     * Counts hardware events (cycles, instructions, LLC, dTLB and
+     * branch misses) in every phase and iteration from now on, through
+     * perf_event_open(2). Should be called before anything runs in
+     * parallel, so that the threads started later are counted. Returns
+     * the number of events that can be counted; where perf events are
+     * not permitted, it is 0 and the statistics leave the counters out.
+     */
+    size_t enable_perf_counters();
+
     const void error(const char *p,const char *p2 = "");
 
     /*
-     * Reads the graph described in filename.
+     * Reads the graph described in filename. Unless build is set to
+     * false, the hyperlink matrix is built from it with build_graph().
+     */
+    int read_file(const string &filename, bool build = true);
+
+    /*
+     * Builds the compressed sparse row form of the hyperlink matrix from
+     * all queued arcs. The arcs are bucketed with two stable counting
+     * sort passes (by source, then by destination), so that every row
+     * ends up sorted by source; duplicate arcs are then dropped in a
+     * single pass, which also counts the outgoing links of each vertex.
+     * pagerank() calls it if there are queued arcs.
+     */
+    void build_graph();
+
+    /*
+     * Writes the hyperlink matrix, the number of outgoing links of each
+     * vertex and the vertex names to filename as a binary snapshot. The
+     * snapshot is versioned and every section is checksummed and aligned
+     * to a page boundary, so that load_binary() can use it in place. The
+     * in-links are stored in 32 bits when there are fewer than 2^32
+     * vertices, as the iterations read them.
+     */
+    int save_binary(const string &filename);
+
+    /*
+     * Loads a snapshot written by save_binary(). The file is mapped into
+     * memory and the table refers to its contents directly, without
+     * parsing or copying anything. The header is always checked; if
+     * verify is set the section checksums are checked too, which reads
+     * the whole file.
+     */
+    int load_binary(const string &filename, bool verify = false);
+
+    /*
+     * Reads the graph in filename, like read_file(), for calculating its
+     * pagerank out of core: the arcs are written to dir, in shards of
+     * rows consecutive destination vertices (rounded up to a multiple of
+     * REDUCE_BLOCK), and only the vertex names or IDs and the number of
+     * outgoing links of each vertex are kept in memory. The file is read
+     * once; each shard's arcs are then sorted on their own, so a shard
+     * rather than the graph must fit in memory. The table is left as
+     * load_shards(dir) would leave it. The graph must have fewer than
+     * 2^32 vertices.
+     */
+    int shard_file(const string &filename, const string &dir,
+                   size_t rows = DEFAULT_SHARD_ROWS);
+
+    /*
+     * Loads the shards written by shard_file() to dir. pagerank() then
+     * streams the in-links from the shards in every iteration, with the
+     * power method; nothing else that needs the hyperlink matrix can be
+     * used on the table.
      */
-    int read_file(const string &filename);
+    int load_shards(const string &dir);
+
+    /*
+     * Renumbers the vertices in the given order, to improve the locality
+     * of the in-links of each row for the iterations. The hyperlink
+     * matrix, the outgoing link counts and any pagerank vector are
+     * renumbered together; vertex names are kept, so get_node_name()
+     * and the output functions still report the original names. Numeric
+     * vertices are treated as renumbered afterwards, as with set_remap().
+     * The time taken and the time of a gather over all rows before and
+     * after are reported on cerr.
+     */
+    void reorder_vertices(Reorder method);
 
     /*
      * Calculates the pagerank of the hyperlink matrix.
      */
     void pagerank();
 
+    /*
+     * Calculates the pagerank of a sharded graph, loaded with
+     * load_shards(), as one of the workers connected by transport. Each
+     * worker loads only its part of the shards, a range of rows with
+     * about the same number of in-links, and in every iteration sends
+     * each other worker the contributions of its vertices that the
+     * other's in-links refer to. The sums for normalisation, dangling
+     * vertices and convergence are reduced over all workers, so the
+     * results are those of pagerank(). Only the shard index and the
+     * worker's own shards are read. When it returns, worker 0 has the
+     * whole pagerank vector; for the others it holds only their own
+     * rows, from the first one.
+     */
+    void distributed_pagerank(Transport &transport);
+
+    /*
+     * Adds a batch of arcs, given as (from, to) vertex numbers, to the
+     * graph. Vertices past the last one are added as needed. Arcs that
+     * are already in the graph are ignored.
+     */
+    void add_arcs(const vector<pair<size_t, size_t> > &arcs);
+
+    /*
+     * Removes a batch of arcs, given as (from, to) vertex numbers, from
+     * the graph. Arcs that are not in the graph are ignored. Vertices
+     * are never removed, even if they are left without any arcs.
+     */
+    void remove_arcs(const vector<pair<size_t, size_t> > &arcs);
+
+    /*
+     * Reads a file of arc changes and applies them all in one batch.
+     * Each line is "+" or "-" followed by an arc in the format of
+     * read_file(); "+" adds the arc, "-" removes it. The result is that
+     * of applying the lines in order: when an arc changes more than
+     * once, its last change counts.
+     */
+    int read_changes(const string &filename);
+
+    /*
+     * Brings the pagerank vector up to date with the arcs added and
+     * removed since the last call to pagerank() or update_pagerank().
+     * The old vector is taken as the starting point and only the
+     * residual caused by the changed arcs is pushed along out-links
+     * until the residuals left add up to less than convergence, where
+     * the power method stops too. The work done follows the rank the
+     * changes move, not the size of the graph: adding one arc to a
+     * graph of 20000 vertices and 320000 arcs pushes along 20 to 70000
+     * arcs, against 9 million for a full calculation, and changing 3%
+     * of the arcs about 2 million. Once the arcs pushed pass those of
+     * the last full calculation, which happened between 3% and 10% of
+     * the arcs changed on random graphs, it calls pagerank() instead,
+     * so an update costs at most about twice a full calculation. Also
+     * calls pagerank() if there is no vector to start from.
+     */
+    void update_pagerank();
+
+    /*
+     * Calculates personalized pageranks for a batch of teleport vectors,
+     * given sparsely as (vertex, weight) pairs; each vector is scaled to
+     * sum to one. Random jumps, including those from dangling vertices,
+     * go to the vertices of the teleport vector. All vectors are iterated
+     * together with the power method, in a vertex-major layout, so every
+     * in-link read serves all of them. A vector leaves the batch as soon
+     * as it has converged.
+     */
+    void personalized_pagerank(
+        const vector<vector<pair<size_t, double> > > &teleport);
+
+    /*
+     * Returns the results of personalized_pagerank(), vertex major: the
+     * pagerank of vertex i for teleport vector s is at
+     * [i * get_num_personalized() + s].
+     */
+    const vector<double>& get_personalized_pagerank();
+
+    /*
+     * Returns the number of teleport vectors of the last call to
+     * personalized_pagerank().
+     */
+    const size_t get_num_personalized();
+
+    /*
+     * Approximates the personalized pagerank of a single seed vertex, as
+     * personalized_pagerank() would calculate it for a teleport vector
+     * holding only the seed, by pushing residual along out-links from
+     * the seed outwards (Andersen, Chung and Lang). A vertex is pushed
+     * while its residual is at least epsilon times its number of
+     * out-links, so only the neighbourhood of the seed is visited and
+     * the work is bounded by 1 / ((1 - alpha) * epsilon), whatever the
+     * size of the graph. On return top holds the k vertices with the
+     * highest pagerank, as (vertex, pagerank) pairs in decreasing order
+     * of pagerank, or all vertices reached if k is 0.
+     */
+    void local_pagerank(size_t seed, double epsilon, size_t k,
+                        vector<pair<size_t, double> > &top);
+
+    /*
+     * Returns the number of the vertex with the given name, interpreted
+     * as in read_file(), or IdMap::NOT_FOUND if there is no such vertex.
+     */
+    size_t find_vertex(const string &name);
+
+    /*
+     * Reads seed sets from filename, one per line, as the vertex names
+     * separated by the delimiter, and appends to teleport a vector giving
+     * equal weight to the vertices of each set.
+     */
+    int read_seeds(const string &filename,
+                   vector<vector<pair<size_t, double> > > &teleport);
+
     /*
      * Returns the pagerank vector of the hyperlink matrix.
      */
@@ -151,7 +787,11 @@ public:
      */
     const string get_node_name(size_t index);
 
-    const map<size_t, string>& get_mapping();
+    /*
+     * Returns the string IDs of the nodes, indexed by their numeric IDs.
+     * The mapping is only populated if the nodes are not numeric.
+     */
+    const StringPool& get_mapping();
     
     /*
      * Returns the pagerank damping factor.
@@ -187,6 +827,171 @@ public:
      */
     void set_convergence(double c);
 
+    /*
+     * Returns the number of threads used for the pagerank calculation.
+     */
+    const size_t get_num_threads();
+
+    /*
+     * Sets the number of threads used for the pagerank calculation.
+     */
+    void set_num_threads(size_t n);
+
+    /*
+     * Returns the method used to solve the pagerank equations.
+     */
+    const Solver get_solver();
+
+    /*
+     * Sets the method used to solve the pagerank equations. On several
+     * threads the Gauss-Seidel and SOR sweeps only use this sweep's
+     * values for in-links from the thread's own block of rows, so they
+     * need more iterations as threads are added, up to as many as the
+     * power method.
+     */
+    void set_solver(Solver s);
+
+    /*
+     * Returns the relaxation factor used by SOLVER_SOR.
+     */
+    const double get_omega();
+
+    /*
+     * Sets the relaxation factor used by SOLVER_SOR. It should be
+     * between 0 and 2; 1 gives plain Gauss-Seidel iteration.
+     * Convergence is only guaranteed up to 1, as the hyperlink matrix
+     * is not symmetric; with more, pagerank() stops with an error when
+     * the difference between sweeps is not finite or has not reached
+     * a new low for DIVERGENCE_SWEEPS sweeps.
+     */
+    void set_omega(double w);
+
+    /*
+     * Returns the extrapolation applied to the power method.
+     */
+    const Extrapolation get_extrapolation();
+
+    /*
+     * Sets the extrapolation applied to the iterates of the power
+     * method, to reach convergence in fewer passes over the in-links.
+     * It keeps the last two or three iterates, at the cost of as many
+     * vectors of doubles, and has no effect with the other solvers.
+     */
+    void set_extrapolation(Extrapolation e);
+
+    /*
+     * Returns the number of iterations between extrapolations.
+     */
+    const size_t get_extrapolation_period();
+
+    /*
+     * Sets the number of power iterations between extrapolations. The
+     * iterates must settle between extrapolations for them to pay off;
+     * it is at least the number of iterates each extrapolation uses.
+     */
+    void set_extrapolation_period(size_t p);
+
+    /*
+     * Returns true if pagerank() lumps the dangling vertices.
+     */
+    const bool get_lump_dangling();
+
+    /*
+     * Sets whether pagerank() lumps the dangling vertices into one, so
+     * that each iteration only reads the rows and vectors of the
+     * vertices with out-links. The vertices are first renumbered with
+     * REORDER_DANGLING, unless the dangling ones already come last. It
+     * iterates over uncompressed in-links with the power method, and
+     * takes precedence over the solver and extrapolation.
+     */
+    void set_lump_dangling(bool l);
+
+    /*
+     * Returns how the power method reads the hyperlink matrix.
+     */
+    const IterationKernel get_iteration_kernel();
+
+    /*
+     * Sets how the power method reads the hyperlink matrix. The push
+     * kernel needs four more bytes per in-link, plus a contribution,
+     * and fewer than 2^31 vertices. It is only used with the power
+     * method on uncompressed in-links, without extrapolation or
+     * lumping.
+     */
+    void set_iteration_kernel(IterationKernel k);
+
+    /*
+     * Returns true if the iterations are placed on the NUMA nodes.
+     */
+    const bool get_numa();
+
+    /*
+     * Sets whether pagerank() pins each thread to a CPU and moves the
+     * rows it works on, with their in-links and the vectors of those
+     * vertices, to the memory of the thread's NUMA node. Threads are
+     * given to the nodes in runs, so that each node works on adjacent
+     * rows. It applies to the pull iterations, which KERNEL_AUTO then
+     * keeps to; the push kernel and lumping are left to the
+     * kernel's first touch policy, with a warning.
+     */
+    void set_numa(bool n);
+
+    /*
+     * Returns true if each NUMA node gathers from its own copy of the
+     * contributions.
+     */
+    const bool get_numa_replicate();
+
+    /*
+     * Sets whether, with NUMA placement, every node keeps its own copy
+     * of the contributions, the vector the gather reads at random, so
+     * that it is never read across nodes; each thread writes its
+     * contributions to every copy instead. It implies set_numa(true),
+     * and applies to the power method on machines with more than one
+     * node.
+     */
+    void set_numa_replicate(bool r);
+
+    /*
+     * Returns true if the iterations use single precision ranks.
+     */
+    const bool get_float_ranks();
+
+    /*
+     * Sets whether the iterations keep the contribution of each vertex
+     * in single rather than double precision. This halves the memory
+     * read by the gather over the in-links, at the cost of accuracy in
+     * the order of 1e-7 relative to each rank, so the convergence
+     * criterion should not be set much lower than that. Sums are still
+     * accumulated in double.
+     */
+    void set_float_ranks(bool f);
+
+    /*
+     * Returns true if the iterations use compressed in-links.
+     */
+    const bool get_compress();
+
+    /*
+     * Sets whether pagerank() compresses the in-links before iterating,
+     * keeping them compressed in memory and decoding each block of rows
+     * as it is used. The in-links take a few bytes rather than eight
+     * each, when in-links are mostly close to each other. Only graphs
+     * with fewer than 2^32 vertices are compressed.
+     */
+    void set_compress(bool c);
+
+    /*
+     * Returns true when every iteration is logged to cerr.
+     */
+    const bool get_verbose();
+
+    /*
+     * Sets logging of the difference between successive iterations
+     * to cerr, so that the convergence of the solvers can be compared.
+     */
+    void set_verbose(bool v);
+
     /*
      * Returns true when tracing output is enabled, false otherwise.
      */
@@ -210,6 +1015,20 @@ public:
      */
     void set_numeric(bool n);
 
+    /*
+     * Returns true if numeric vertex IDs are renumbered densely.
+     */
+    const bool get_remap();
+
+    /*
+     * Specifies whether numeric vertex IDs read by read_file(string&)
+     * are arbitrary 64-bit values rather than zero-based indices. If so
+     * they are renumbered to 0..n-1, where n is the number of distinct
+     * IDs, and get_node_name(size_t) returns the original ID. Only has
+     * an effect for numeric graph data.
+     */
+    void set_remap(bool r);
+
     /*
      * Returns the delimeter used in the graph data file. The data
      * file is composed of lines with the following format:
@@ -231,6 +1050,12 @@ public:
      * - the convergence criterion (convergence)
      * - the maximum number of iterations (max iterations)
      * - whether numeric or string input is expected (numeric)
+     * - whether numeric vertex IDs are renumbered densely (remap)
+     * - the number of threads used for the calculation (threads)
+     * - the method for solving the pagerank equations (solver)
+     * - the relaxation factor of the SOR solver (omega)
+     * - the precision of the ranks during the iterations (ranks)
+     * - the gather implementation for the CPU (gather)
      * - the delimiter for separating the two vertices in each line of the
      *   input file (delim)
      */
@@ -262,4 +1087,34 @@ public:
      * and also outputs the index number of each vector, starting from zero.
      */
     const void print_pagerank_v();
+
+    /*
+     * Outputs ranked vertices, as returned by local_pagerank(), as
+     * lines of the form <node> = <pagerank value>.
+     */
+    const void print_ranked(const vector<pair<size_t, double> > &ranked);
+
+    /*
+     * Sets top to the k vertices with the highest pagerank, as
+     * (vertex, pagerank) pairs in decreasing order of pagerank, ties
+     * going to the lower vertex number. Each thread selects the k
+     * highest of its share of the vertices before they are merged, so
+     * the pagerank vector is neither copied nor sorted.
+     */
+    void top_pagerank(size_t k, vector<pair<size_t, double> > &top);
+
+    /*
+     * Writes the pagerank vector to filename in binary: a header, the
+     * ranks as an array of float if single is set or of double
+     * otherwise, and the original IDs or names of the vertices, unless
+     * they are numbered as in the graph file. Meant for consumers that
+     * would otherwise parse the text output of millions of vertices.
+     */
+    int save_pagerank_binary(const string &filename, bool single = false);
+
+    /*
+     * Outputs the personalized pageranks, one line per vertex:
+     * <node> = <pagerank for each teleport vector>
+     */
+    const void print_personalized_v();
 };
@@ -0,0 +1,564 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <atomic>
+#include <stdint.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "transport.h"
+
+using namespace std;
+
+/* Connecting to a worker that is not listening yet is retried this long */
+static const int CONNECT_RETRY_MS = 30000;
+
+static void fail(const char *what, const char *detail = "") {
+    cerr << what << ' ' << detail << ": " << strerror(errno) << endl;
+    exit(1);
+}
+
+const char *transport_name(TransportKind k) {
+    switch (k) {
+    case TRANSPORT_UNIX:
+        return "unix";
+    case TRANSPORT_TCP:
+        return "tcp";
+    default:
+        return "shm";
+    }
+}
+
+bool parse_transport(const char *name, TransportKind &k) {
+    for (TransportKind c : { TRANSPORT_SHM, TRANSPORT_UNIX, TRANSPORT_TCP }) {
+        if (!strcmp(name, transport_name(c))) {
+            k = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * A socket address, resolved from a Unix-domain socket path or a
+ * "host:port" string.
+ */
+struct SocketAddress {
+    sockaddr_storage addr;
+    socklen_t len;
+    int family;
+};
+
+static SocketAddress resolve(const string &address) {
+    SocketAddress a;
+    memset(&a, 0, sizeof(a));
+    if (address.find('/') != string::npos) {
+        sockaddr_un *un = (sockaddr_un *) &a.addr;
+        if (address.size() >= sizeof(un->sun_path)) {
+            errno = ENAMETOOLONG;
+            fail("Invalid socket path", address.c_str());
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, address.c_str());
+        a.len = sizeof(sockaddr_un);
+        a.family = AF_UNIX;
+        return a;
+    }
+    size_t colon = address.rfind(':');
+    if (colon == string::npos) {
+        errno = EINVAL;
+        fail("Invalid address, expected host:port:", address.c_str());
+    }
+    string host = address.substr(0, colon);
+    string port = address.substr(colon + 1);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *res;
+    int rc = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(),
+                         &hints, &res);
+    if (rc != 0) {
+        cerr << "Cannot resolve " << address << ": " << gai_strerror(rc)
+             << endl;
+        exit(1);
+    }
+    memcpy(&a.addr, res->ai_addr, res->ai_addrlen);
+    a.len = res->ai_addrlen;
+    a.family = res->ai_family;
+    freeaddrinfo(res);
+    return a;
+}
+
+/*
+ * Returns a socket listening at address.
+ */
+static int listen_at(const string &address) {
+    SocketAddress a = resolve(address);
+    int fd = socket(a.family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fail("Cannot create socket for", address.c_str());
+    }
+    if (a.family == AF_UNIX) {
+        unlink(address.c_str());
+    } else {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (bind(fd, (sockaddr *) &a.addr, a.len) < 0 || listen(fd, 128) < 0) {
+        fail("Cannot listen at", address.c_str());
+    }
+    return fd;
+}
+
+static void write_all(int fd, const void *p, size_t n) {
+    const char *c = (const char *) p;
+    while (n > 0) {
+        ssize_t k = write(fd, c, n);
+        if (k < 0 && errno == EINTR) {
+            continue;
+        }
+        if (k <= 0) {
+            fail("Cannot write to worker");
+        }
+        c += k;
+        n -= k;
+    }
+}
+
+static void read_all(int fd, void *p, size_t n) {
+    char *c = (char *) p;
+    while (n > 0) {
+        ssize_t k = read(fd, c, n);
+        if (k < 0 && errno == EINTR) {
+            continue;
+        }
+        if (k <= 0) {
+            fail("Cannot read from worker");
+        }
+        c += k;
+        n -= k;
+    }
+}
+
+SocketTransport::SocketTransport(size_t rank, const vector<string> &addresses,
+                                 int listen_fd)
+    : Transport(rank, addresses.size()), fds(addresses.size(), -1) {
+
+    if (listen_fd < 0) {
+        listen_fd = listen_at(addresses[rank]);
+    }
+
+    /*
+     * Every worker connects to those numbered below it and introduces
+     * itself, then accepts the connections of those numbered above it.
+     */
+    for (size_t p = 0; p < rank; p++) {
+        SocketAddress a = resolve(addresses[p]);
+        int fd = -1;
+        for (int waited = 0; ; waited += 10) {
+            fd = socket(a.family, SOCK_STREAM, 0);
+            if (fd < 0) {
+                fail("Cannot create socket for", addresses[p].c_str());
+            }
+            if (connect(fd, (sockaddr *) &a.addr, a.len) == 0) {
+                break;
+            }
+            close(fd);
+            if (waited >= CONNECT_RETRY_MS) {
+                fail("Cannot connect to", addresses[p].c_str());
+            }
+            usleep(10000);
+        }
+        uint64_t me = rank;
+        write_all(fd, &me, sizeof(me));
+        fds[p] = fd;
+    }
+    for (size_t k = rank + 1; k < num_workers; k++) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            fail("Cannot accept worker at", addresses[rank].c_str());
+        }
+        uint64_t peer;
+        read_all(fd, &peer, sizeof(peer));
+        if (peer <= rank || peer >= num_workers || fds[peer] >= 0) {
+            errno = EPROTO;
+            fail("Unexpected worker connecting to", addresses[rank].c_str());
+        }
+        fds[peer] = fd;
+    }
+    close(listen_fd);
+
+    for (size_t p = 0; p < num_workers; p++) {
+        if (p == rank) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(fds[p], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(fds[p], F_SETFL, fcntl(fds[p], F_GETFL) | O_NONBLOCK);
+    }
+}
+
+SocketTransport::~SocketTransport() {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+size_t SocketTransport::exchange(const vector<vector<char> > &out,
+                                 vector<vector<char> > &in) {
+
+    /*
+     * Each message is sent as its length followed by its bytes. All
+     * sockets are served as they become ready, so that no worker waits
+     * for a peer that is itself blocked on a full socket.
+     */
+    struct Progress {
+        uint64_t out_len;
+        uint64_t in_len;
+        size_t sent; // bytes of the length and the message sent
+        size_t received;
+    };
+    vector<Progress> progress(num_workers);
+    size_t pending = 0;
+    size_t bytes = 0;
+    in.resize(num_workers);
+    for (size_t p = 0; p < num_workers; p++) {
+        in[p].clear();
+        if (p != my_rank) {
+            progress[p].out_len = out[p].size();
+            progress[p].in_len = 0;
+            progress[p].sent = 0;
+            progress[p].received = 0;
+            pending += 2;
+            bytes += out[p].size() + sizeof(uint64_t);
+        }
+    }
+
+    const size_t header = sizeof(uint64_t);
+    vector<pollfd> polled;
+    vector<size_t> peers;
+    while (pending > 0) {
+        polled.clear();
+        peers.clear();
+        for (size_t p = 0; p < num_workers; p++) {
+            if (p == my_rank) {
+                continue;
+            }
+            Progress &g = progress[p];
+            short events = 0;
+            if (g.sent < header + g.out_len) {
+                events |= POLLOUT;
+            }
+            if (g.received < header
+                || g.received < header + g.in_len) {
+                events |= POLLIN;
+            }
+            if (events) {
+                polled.push_back(pollfd { fds[p], events, 0 });
+                peers.push_back(p);
+            }
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("Cannot poll workers");
+        }
+        for (size_t k = 0; k < polled.size(); k++) {
+            size_t p = peers[k];
+            Progress &g = progress[p];
+            if (polled[k].revents & POLLOUT) {
+                ssize_t n;
+                if (g.sent < header) {
+                    n = write(fds[p], (const char *) &g.out_len + g.sent,
+                              header - g.sent);
+                } else {
+                    n = write(fds[p], out[p].data() + (g.sent - header),
+                              g.out_len - (g.sent - header));
+                }
+                if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    fail("Cannot write to worker");
+                }
+                if (n > 0) {
+                    g.sent += n;
+                    if (g.sent == header + g.out_len) {
+                        pending--;
+                    }
+                }
+            }
+            if (polled[k].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ssize_t n;
+                if (g.received < header) {
+                    n = read(fds[p], (char *) &g.in_len + g.received,
+                             header - g.received);
+                } else {
+                    n = read(fds[p], in[p].data() + (g.received - header),
+                             g.in_len - (g.received - header));
+                }
+                if (n == 0) {
+                    errno = ECONNRESET;
+                    fail("Cannot read from worker");
+                }
+                if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    fail("Cannot read from worker");
+                }
+                if (n > 0) {
+                    g.received += n;
+                    if (g.received == header) {
+                        in[p].resize(g.in_len);
+                    }
+                    if (g.received == header + g.in_len) {
+                        pending--;
+                    }
+                }
+            }
+        }
+    }
+    return bytes;
+}
+
+/*
+ * The mailbox of an ordered pair of workers in the shared region. The
+ * sender fills it when it is empty (sent == taken) and bumps sent; the
+ * receiver empties it and bumps taken.
+ */
+static const size_t MAILBOX_CAPACITY = 1 << 18;
+
+struct Mailbox {
+    atomic<uint64_t> sent;
+    atomic<uint64_t> taken;
+    uint64_t total; // the length of the whole message
+    uint64_t length; // the length of this piece
+    char data[MAILBOX_CAPACITY];
+};
+
+static Mailbox *mailbox(char *region, size_t n, size_t from, size_t to) {
+    return (Mailbox *) region + (from * n + to);
+}
+
+size_t SharedMemoryTransport::region_size(size_t n) {
+    return n * n * sizeof(Mailbox);
+}
+
+SharedMemoryTransport::SharedMemoryTransport(size_t rank, size_t n, void *r)
+    : Transport(rank, n), region((char *) r) {
+}
+
+size_t SharedMemoryTransport::exchange(const vector<vector<char> > &out,
+                                       vector<vector<char> > &in) {
+
+    /* Every message takes at least one piece, even if it is empty */
+    vector<size_t> sent(num_workers, 0);
+    vector<bool> out_done(num_workers, false);
+    vector<size_t> received(num_workers, 0);
+    vector<bool> in_done(num_workers, false);
+    vector<bool> in_started(num_workers, false);
+    size_t pending = 2 * (num_workers - 1);
+    size_t bytes = 0;
+    in.resize(num_workers);
+
+    while (pending > 0) {
+        bool progress = false;
+        for (size_t p = 0; p < num_workers; p++) {
+            if (p == my_rank) {
+                continue;
+            }
+            Mailbox *m = mailbox(region, num_workers, my_rank, p);
+            if (!out_done[p] && m->sent.load(memory_order_relaxed)
+                == m->taken.load(memory_order_acquire)) {
+                size_t len = min(MAILBOX_CAPACITY, out[p].size() - sent[p]);
+                memcpy(m->data, out[p].data() + sent[p], len);
+                m->total = out[p].size();
+                m->length = len;
+                m->sent.fetch_add(1, memory_order_release);
+                sent[p] += len;
+                bytes += len;
+                if (sent[p] == out[p].size()) {
+                    out_done[p] = true;
+                    pending--;
+                }
+                progress = true;
+            }
+            m = mailbox(region, num_workers, p, my_rank);
+            if (!in_done[p] && m->sent.load(memory_order_acquire)
+                != m->taken.load(memory_order_relaxed)) {
+                if (!in_started[p]) {
+                    in[p].resize(m->total);
+                    in_started[p] = true;
+                }
+                memcpy(in[p].data() + received[p], m->data, m->length);
+                received[p] += m->length;
+                m->taken.fetch_add(1, memory_order_release);
+                if (received[p] == in[p].size()) {
+                    in_done[p] = true;
+                    pending--;
+                }
+                progress = true;
+            }
+        }
+        if (!progress) {
+            sched_yield();
+        }
+    }
+    return bytes;
+}
+
+bool run_workers(size_t n, TransportKind kind,
+                 const function<void(Transport &)> &body) {
+
+    /*
+     * Everything the workers need to find each other is set up before
+     * they are forked: the shared region, or a listening socket for
+     * each of them.
+     */
+    void *region = NULL;
+    size_t region_bytes = 0;
+    vector<string> addresses(n);
+    vector<int> listeners(n, -1);
+    char dir[] = "/tmp/pagerank-XXXXXX";
+    if (kind == TRANSPORT_SHM) {
+        region_bytes = SharedMemoryTransport::region_size(n);
+        region = mmap(NULL, region_bytes, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            fail("Cannot map shared memory for workers");
+        }
+    } else if (kind == TRANSPORT_UNIX) {
+        if (mkdtemp(dir) == NULL) {
+            fail("Cannot create directory", dir);
+        }
+        for (size_t w = 0; w < n; w++) {
+            addresses[w] = string(dir) + "/worker-" + to_string(w);
+            listeners[w] = listen_at(addresses[w]);
+        }
+    } else {
+        for (size_t w = 0; w < n; w++) {
+            listeners[w] = listen_at("127.0.0.1:0");
+            sockaddr_in a;
+            socklen_t len = sizeof(a);
+            getsockname(listeners[w], (sockaddr *) &a, &len);
+            addresses[w] = "127.0.0.1:" + to_string(ntohs(a.sin_port));
+        }
+    }
+
+    cout.flush();
+    cerr.flush();
+    vector<pid_t> pids(n);
+    for (size_t w = 0; w < n; w++) {
+        pids[w] = fork();
+        if (pids[w] < 0) {
+            fail("Cannot fork worker");
+        }
+        if (pids[w] == 0) {
+            for (size_t k = 0; k < n; k++) {
+                if (k != w && listeners[k] >= 0) {
+                    close(listeners[k]);
+                }
+            }
+            if (kind == TRANSPORT_SHM) {
+                SharedMemoryTransport t(w, n, region);
+                body(t);
+            } else {
+                SocketTransport t(w, addresses, listeners[w]);
+                body(t);
+            }
+            cout.flush();
+            cerr.flush();
+            _exit(0);
+        }
+    }
+
+    for (int fd : listeners) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    /* If a worker fails the others would wait for it forever */
+    bool ok = true;
+    size_t running = n;
+    while (running > 0) {
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        running--;
+        for (size_t w = 0; w < n; w++) {
+            if (pids[w] == pid) {
+                pids[w] = 0;
+            }
+        }
+        if (ok && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+            ok = false;
+            for (pid_t other : pids) {
+                if (other > 0) {
+                    kill(other, SIGTERM);
+                }
+            }
+        }
+    }
+    if (region) {
+        munmap(region, region_bytes);
+    }
+    if (kind == TRANSPORT_UNIX) {
+        for (const string &a : addresses) {
+            unlink(a.c_str());
+        }
+        rmdir(dir);
+    }
+    return ok;
+}
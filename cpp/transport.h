@@ -0,0 +1,149 @@
+/* Copyright (c) 2010-2011, Panos Louridas, GRNET S.A.
+ 
+   All rights reserved.
+  
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+ 
+   * Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ 
+   * Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the
+   distribution.
+ 
+   * Neither the name of GRNET S.A, nor the names of its contributors
+   may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+  
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+   INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+   SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+   STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+   OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstddef>
+
+/*
+ * The ways worker processes can exchange messages:
+ * - TRANSPORT_SHM: mailboxes in memory shared by processes forked on
+ *   one machine
+ * - TRANSPORT_UNIX: Unix-domain stream sockets, on one machine
+ * - TRANSPORT_TCP: TCP connections, between machines
+ */
+enum TransportKind {
+    TRANSPORT_SHM,
+    TRANSPORT_UNIX,
+    TRANSPORT_TCP
+};
+
+/*
+ * Returns the name of a transport, as accepted by parse_transport().
+ */
+const char *transport_name(TransportKind k);
+
+/*
+ * Sets k to the transport called name ("shm", "unix" or "tcp").
+ * Returns false if there is no such transport.
+ */
+bool parse_transport(const char *name, TransportKind &k);
+
+/*
+ * Connects the workers of a distributed calculation, numbered from 0
+ * to size() - 1, and exchanges messages between all of them at once.
+ */
+class Transport {
+protected:
+    size_t my_rank;
+    size_t num_workers;
+
+public:
+    Transport(size_t r, size_t n) : my_rank(r), num_workers(n) { }
+    virtual ~Transport() { }
+
+    size_t rank() const { return my_rank; }
+    size_t size() const { return num_workers; }
+
+    /*
+     * Sends out[p] to every other worker p and sets in[p] to what p
+     * sent to this worker; out[rank()] is not sent. Every worker must
+     * call exchange() the same number of times. Returns the number of
+     * bytes sent.
+     */
+    virtual size_t exchange(const std::vector<std::vector<char> > &out,
+                            std::vector<std::vector<char> > &in) = 0;
+};
+
+/*
+ * Exchanges messages over one stream socket per pair of workers.
+ * Addresses are paths of Unix-domain sockets if they contain a '/' and
+ * "host:port" for TCP otherwise.
+ */
+class SocketTransport : public Transport {
+private:
+    std::vector<int> fds; // fds[p] is connected to worker p
+
+public:
+    /*
+     * Connects worker rank to all the others, listening at
+     * addresses[rank], or on listen_fd if it is already listening there.
+     * Workers that are not up yet are retried for a while.
+     */
+    SocketTransport(size_t rank, const std::vector<std::string> &addresses,
+                    int listen_fd = -1);
+    ~SocketTransport();
+
+    size_t exchange(const std::vector<std::vector<char> > &out,
+                    std::vector<std::vector<char> > &in);
+};
+
+/*
+ * Exchanges messages through a region of shared memory holding a
+ * mailbox for every ordered pair of workers. Longer messages go through
+ * the mailbox in several pieces.
+ */
+class SharedMemoryTransport : public Transport {
+private:
+    char *region;
+
+public:
+    /*
+     * Returns the size of the region for n workers.
+     */
+    static size_t region_size(size_t n);
+
+    /*
+     * Uses region, which must be shared by all n workers and zeroed
+     * before any of them uses it.
+     */
+    SharedMemoryTransport(size_t rank, size_t n, void *region);
+
+    size_t exchange(const std::vector<std::vector<char> > &out,
+                    std::vector<std::vector<char> > &in);
+};
+
+/*
+ * Forks n worker processes on this machine, connected by a transport
+ * of the given kind, runs body in each of them and waits for them all.
+ * Returns true if every worker exited normally.
+ */
+bool run_workers(size_t n, TransportKind kind,
+                 const std::function<void(Transport &)> &body);
+
+#endif